@@ -63,16 +63,16 @@ main(int argc, char **argv) {
     hashtable_add(hashtable, "key3", "element3", sizeof(char *));
 
     /* Print elements of the hashtable */
-    char **keys  = NULL;
-    size_t count = hashtable_get_keys(hashtable, &keys);
-    if (NULL != keys) {
-        for (size_t index = 0; index < count; index++) {
-            char *element = hashtable_lookup(hashtable, keys[index]);
-            if (NULL != element) {
-                printf("%s: %s\n", keys[index], element);
+    hashtable_snapshot_t *snapshot = hashtable_snapshot(hashtable);
+    if (NULL != snapshot) {
+        const char *key;
+        void *      element;
+        for (size_t index = 0; index < hashtable_snapshot_get_count(snapshot); index++) {
+            if (true == hashtable_snapshot_get(snapshot, index, &key, NULL, &element)) {
+                printf("%s: %s\n", key, (char *)element);
             }
         }
-        free(keys);
+        hashtable_snapshot_release(snapshot);
     }
 
     /* Release memory */
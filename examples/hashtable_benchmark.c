@@ -0,0 +1,386 @@
+/**
+ * @file      hashtable_benchmark.c
+ * @brief     Hashtable benchmark example in C
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021-2023 joelguittet and c-hashtable contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+/******************************************************************************/
+/* Definitions                                                                */
+/******************************************************************************/
+
+/**
+ * Number of elements in the hashtable
+ */
+#define BENCHMARK_ELEMENTS (100000)
+
+/**
+ * Number of lookups performed by each thread
+ */
+#define BENCHMARK_LOOKUPS (1000000)
+
+/**
+ * Number of adds performed by each thread
+ */
+#define BENCHMARK_ADDS (200000)
+
+/**
+ * Number of shards of the sharded hashtable
+ */
+#define BENCHMARK_SHARDS (16)
+
+/**
+ * Number of keys of each batched lookup
+ */
+#define BENCHMARK_BATCH (200)
+
+/**
+ * Maximum number of threads
+ */
+#define BENCHMARK_MAX_THREADS (32)
+
+/**
+ * Maximum length of the keys
+ */
+#define BENCHMARK_KEY_LENGTH (32)
+
+/******************************************************************************/
+/* Variables                                                                  */
+/******************************************************************************/
+
+static char keys[BENCHMARK_ELEMENTS][BENCHMARK_KEY_LENGTH]; /**< Keys of the hashtable */
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+
+/**
+ * @brief Thread performing lookups in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *lookup_thread(void *arg);
+
+/**
+ * @brief Thread performing batched lookups in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *lookup_batch_thread(void *arg);
+
+/**
+ * @brief Thread performing adds in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *add_thread(void *arg);
+
+/**
+ * @brief Run benchmark of the lookups with the wanted locking mode, hash function and number of threads
+ * @param lock Locking mode of the hashtable
+ * @param hash Hash function of the hashtable
+ * @param batch true to perform batched lookups
+ * @param threads Number of threads
+ * @return Number of lookups per second, 0 if an error occurred
+ */
+static double benchmark(hashtable_lock_t lock, hashtable_hash_t hash, bool batch, int threads);
+
+/**
+ * @brief Run benchmark of the adds with the wanted number of shards and threads
+ * @param shards Number of shards of the hashtable
+ * @param threads Number of threads
+ * @return Number of adds per second, 0 if an error occurred
+ */
+static double benchmark_add(size_t shards, int threads);
+
+/**
+ * @brief Run benchmark of the load of all the keys in an empty hashtable
+ * @param bulk true to load the keys with hashtable_add_bulk, false to add them one by one
+ * @return Number of adds per second, 0 if an error occurred
+ */
+static double benchmark_load(bool bulk);
+
+/******************************************************************************/
+/* Functions                                                                  */
+/******************************************************************************/
+
+/**
+ * @brief Main function
+ * @param argc Number of arguments
+ * @param argv Arguments, the first one is the maximum number of threads
+ * @return Always returns 0
+ */
+int
+main(int argc, char **argv) {
+
+    /* Retrieve maximum number of threads */
+    int max_threads = (1 < argc) ? atoi(argv[1]) : 8;
+    if ((1 > max_threads) || (BENCHMARK_MAX_THREADS < max_threads)) {
+        printf("number of threads should be between 1 and %d\n", BENCHMARK_MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Initialize keys */
+    for (int index = 0; index < BENCHMARK_ELEMENTS; index++) {
+        snprintf(keys[index], BENCHMARK_KEY_LENGTH, "key%d", index);
+    }
+
+    /* Run benchmarks */
+    printf("threads  mutex (lookups/s)  rwlock (lookups/s)  rcu (lookups/s)\n");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double mutex  = benchmark(HASHTABLE_LOCK_MUTEX, HASHTABLE_HASH_WYHASH, false, threads);
+        double rwlock = benchmark(HASHTABLE_LOCK_RWLOCK, HASHTABLE_HASH_WYHASH, false, threads);
+        double rcu    = benchmark(HASHTABLE_LOCK_RCU, HASHTABLE_HASH_WYHASH, false, threads);
+        printf("%7d  %17.0f  %18.0f  %15.0f\n", threads, mutex, rwlock, rcu);
+    }
+    printf("\nthreads  djb2 (lookups/s)  wyhash (lookups/s)  siphash (lookups/s)\n");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double djb2    = benchmark(HASHTABLE_LOCK_RWLOCK, HASHTABLE_HASH_DJB2, false, threads);
+        double wyhash  = benchmark(HASHTABLE_LOCK_RWLOCK, HASHTABLE_HASH_WYHASH, false, threads);
+        double siphash = benchmark(HASHTABLE_LOCK_RWLOCK, HASHTABLE_HASH_SIPHASH, false, threads);
+        printf("%7d  %16.0f  %18.0f  %19.0f\n", threads, djb2, wyhash, siphash);
+    }
+    printf("\nthreads  single (lookups/s)  batch (lookups/s)\n");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double single = benchmark(HASHTABLE_LOCK_MUTEX, HASHTABLE_HASH_WYHASH, false, threads);
+        double batch  = benchmark(HASHTABLE_LOCK_MUTEX, HASHTABLE_HASH_WYHASH, true, threads);
+        printf("%7d  %18.0f  %17.0f\n", threads, single, batch);
+    }
+    printf("\nthreads  1 shard (adds/s)  %d shards (adds/s)\n", BENCHMARK_SHARDS);
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double single  = benchmark_add(1, threads);
+        double sharded = benchmark_add(BENCHMARK_SHARDS, threads);
+        printf("%7d  %16.0f  %18.0f\n", threads, single, sharded);
+    }
+    printf("\nadd (adds/s)  add_bulk (adds/s)\n");
+    double add  = benchmark_load(false);
+    double bulk = benchmark_load(true);
+    printf("%12.0f  %17.0f\n", add, bulk);
+
+    return 0;
+}
+
+/**
+ * @brief Thread performing lookups in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *
+lookup_thread(void *arg) {
+
+    hashtable_t *hashtable = (hashtable_t *)arg;
+
+    /* Perform lookups */
+    unsigned int seed = (unsigned int)pthread_self();
+    for (int index = 0; index < BENCHMARK_LOOKUPS; index++) {
+        hashtable_lookup(hashtable, keys[rand_r(&seed) % BENCHMARK_ELEMENTS]);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Thread performing batched lookups in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *
+lookup_batch_thread(void *arg) {
+
+    hashtable_t *hashtable = (hashtable_t *)arg;
+    char *       batch[BENCHMARK_BATCH];
+    void *       values[BENCHMARK_BATCH];
+
+    /* Perform lookups by batches */
+    unsigned int seed = (unsigned int)pthread_self();
+    for (int index = 0; index < BENCHMARK_LOOKUPS; index += BENCHMARK_BATCH) {
+        for (int key = 0; key < BENCHMARK_BATCH; key++) {
+            batch[key] = keys[rand_r(&seed) % BENCHMARK_ELEMENTS];
+        }
+        hashtable_lookup_batch(hashtable, batch, BENCHMARK_BATCH, values);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Thread performing adds in the hashtable
+ * @param arg Hashtable instance
+ * @return Always returns NULL
+ */
+static void *
+add_thread(void *arg) {
+
+    hashtable_t *hashtable = (hashtable_t *)arg;
+
+    /* Perform adds, keys are added again once all of them have been added */
+    unsigned int seed = (unsigned int)pthread_self();
+    for (int index = 0; index < BENCHMARK_ADDS; index++) {
+        hashtable_add(hashtable, keys[rand_r(&seed) % BENCHMARK_ELEMENTS], NULL, 0);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Run benchmark of the lookups with the wanted locking mode, hash function and number of threads
+ * @param lock Locking mode of the hashtable
+ * @param hash Hash function of the hashtable
+ * @param batch true to perform batched lookups
+ * @param threads Number of threads
+ * @return Number of lookups per second, 0 if an error occurred
+ */
+static double
+benchmark(hashtable_lock_t lock, hashtable_hash_t hash, bool batch, int threads) {
+
+    hashtable_config_t config;
+    hashtable_t *      hashtable;
+    pthread_t          thread[BENCHMARK_MAX_THREADS];
+    struct timespec    start, end;
+
+    /* Create hashtable instance */
+    hashtable_config_init(&config);
+    config.size = BENCHMARK_ELEMENTS;
+    config.lock = lock;
+    config.hash = hash;
+    if (NULL == (hashtable = hashtable_create_with_config(&config))) {
+        printf("unable to create hashtable instance\n");
+        return 0;
+    }
+
+    /* Add elements to the hashtable */
+    for (int index = 0; index < BENCHMARK_ELEMENTS; index++) {
+        hashtable_add(hashtable, keys[index], keys[index], 0);
+    }
+
+    /* Start threads and wait for their completion */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int index = 0; index < threads; index++) {
+        pthread_create(&thread[index], NULL, (true == batch) ? lookup_batch_thread : lookup_thread, hashtable);
+    }
+    for (int index = 0; index < threads; index++) {
+        pthread_join(thread[index], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    /* Compute number of lookups per second */
+    double duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    return (double)threads * BENCHMARK_LOOKUPS / duration;
+}
+
+/**
+ * @brief Run benchmark of the adds with the wanted number of shards and threads
+ * @param shards Number of shards of the hashtable
+ * @param threads Number of threads
+ * @return Number of adds per second, 0 if an error occurred
+ */
+static double
+benchmark_add(size_t shards, int threads) {
+
+    hashtable_config_t config;
+    hashtable_t *      hashtable;
+    pthread_t          thread[BENCHMARK_MAX_THREADS];
+    struct timespec    start, end;
+
+    /* Create hashtable instance */
+    hashtable_config_init(&config);
+    config.size   = BENCHMARK_ELEMENTS;
+    config.shards = shards;
+    if (NULL == (hashtable = hashtable_create_with_config(&config))) {
+        printf("unable to create hashtable instance\n");
+        return 0;
+    }
+
+    /* Start threads and wait for their completion */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int index = 0; index < threads; index++) {
+        pthread_create(&thread[index], NULL, add_thread, hashtable);
+    }
+    for (int index = 0; index < threads; index++) {
+        pthread_join(thread[index], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    /* Compute number of adds per second */
+    double duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    return (double)threads * BENCHMARK_ADDS / duration;
+}
+
+/**
+ * @brief Run benchmark of the load of all the keys in an empty hashtable
+ * @param bulk true to load the keys with hashtable_add_bulk, false to add them one by one
+ * @return Number of adds per second, 0 if an error occurred
+ */
+static double
+benchmark_load(bool bulk) {
+
+    hashtable_t *   hashtable;
+    static char *   list[BENCHMARK_ELEMENTS];
+    struct timespec start, end;
+
+    /* Create hashtable instance with the default size */
+    if (NULL == (hashtable = hashtable_create(64, false))) {
+        printf("unable to create hashtable instance\n");
+        return 0;
+    }
+    for (int index = 0; index < BENCHMARK_ELEMENTS; index++) {
+        list[index] = keys[index];
+    }
+
+    /* Add all keys, the keys are unique */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (true == bulk) {
+        hashtable_add_bulk(hashtable, list, (void **)list, NULL, BENCHMARK_ELEMENTS, true);
+    } else {
+        for (int index = 0; index < BENCHMARK_ELEMENTS; index++) {
+            hashtable_add(hashtable, list[index], list[index], 0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    /* Compute number of adds per second */
+    double duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    return (double)BENCHMARK_ELEMENTS / duration;
+}
@@ -87,34 +87,429 @@ then using the HASHTABLE_API_VISIBILITY flag to "export" the same symbols the wa
 /* Includes                                                                   */
 /******************************************************************************/
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <semaphore.h>
+#include <pthread.h>
 
 /******************************************************************************/
 /* Definitions                                                                */
 /******************************************************************************/
 
 /**
- * Hashtable element
+ * Load factor above which the hashtable is grown (number of elements per list of elements)
+ */
+#define HASHTABLE_GROW_LOAD_FACTOR (1)
+
+/**
+ * Load factor below which the hashtable is shrunk (one element every HASHTABLE_SHRINK_LOAD_FACTOR lists of elements)
+ */
+#define HASHTABLE_SHRINK_LOAD_FACTOR (8)
+
+/**
+ * Number of lists of elements migrated at each step of the incremental rehash
+ */
+#define HASHTABLE_REHASH_STEP (4)
+
+/**
+ * Maximum number of keys whose hash values are computed before locking the shards in batched lookups
+ */
+#define HASHTABLE_BATCH_SIZE (256)
+
+/**
+ * Number of keys between the prefetch of the memory accessed by a lookup and the lookup itself in batched lookups
+ */
+#define HASHTABLE_PREFETCH_DISTANCE (4)
+
+/**
+ * Maximum number of elements allocated in a single block of memory when elements are added with hashtable_add_bulk
+ */
+#define HASHTABLE_BULK_BLOCK_SIZE (1024)
+
+/**
+ * Number of reader slots used to track readers in HASHTABLE_LOCK_RCU mode, threads are distributed across the slots
+ * Beyond this number of threads, several threads share a slot and their lookups write the same cache line.
+ */
+#define HASHTABLE_EPOCH_SLOTS (32)
+
+/**
+ * Size and alignment of the reader slots, one cache line each so that readers of different slots do not share cache lines
+ */
+#define HASHTABLE_EPOCH_SLOT_SIZE (64)
+
+/**
+ * Number of retired memory blocks in a shard above which reclamation is attempted in HASHTABLE_LOCK_RCU mode
+ */
+#define HASHTABLE_RECLAIM_THRESHOLD (32)
+
+/**
+ * Number of bits of the expiration time handled by each level of the timer wheel, each level has 64 slots of which occupancy is a 64-bit mask
+ */
+#define HASHTABLE_WHEEL_BITS (6)
+
+/**
+ * Number of levels of the timer wheel, expiration times beyond 2^24 milliseconds (about 4.6 hours) are cascaded from the last level
+ */
+#define HASHTABLE_WHEEL_LEVELS (4)
+
+/**
+ * Number of rows of the frequency sketch, the frequency of a key is the minimum of its counters in each row
+ */
+#define HASHTABLE_SKETCH_ROWS (4)
+
+/**
+ * Maximum value of the counters of the frequency sketch
+ */
+#define HASHTABLE_SKETCH_MAX (15)
+
+/**
+ * Number of accesses recorded in the frequency sketch, per counter of a row, after which all counters are halved
+ */
+#define HASHTABLE_SKETCH_AGING (10)
+
+/**
+ * Hashtable block of elements, allocated by hashtable_add_bulk and followed by the elements
+ */
+typedef struct {
+    size_t live; /**< Number of elements of the block still in the hashtable, plus one while the block is being filled */
+} hashtable_block_t;
+
+/**
+ * Hashtable element, allocated with its key
  */
 typedef struct hashtable_element_s {
-    struct hashtable_element_s *next; /**< Next element of the hashtable */
-    char *                      key;  /**< Element key */
-    void *                      e;    /**< Element itself */
+    struct hashtable_element_s * next;       /**< Next element of the hashtable */
+    char *                       key;        /**< Element key, followed by a NUL character */
+    size_t                       key_len;    /**< Length of the element key in bytes */
+    uint64_t                     hash;       /**< Hash value of the element key, compared before the key and used to migrate the element */
+    hashtable_block_t *          block;      /**< Block in which the element is allocated, NULL if the element is allocated alone */
+    void *                       e;          /**< Element itself */
+    size_t                       size;       /**< Size of the element itself in bytes, as given when it has been added or replaced */
+    uint64_t                     version;    /**< Version of the element, unique in its shard and changed each time the element is modified */
+    bool                         referenced; /**< Flag set when the element is accessed, cleared by the clock hand before it is evicted */
+    uint64_t                     expire;     /**< Expiration time in milliseconds of the monotonic clock, 0 if the element does not expire */
+    struct hashtable_element_s * timer_next; /**< Next element of the same slot of the timer wheel */
+    struct hashtable_element_s **timer_prev; /**< Link to the element in the timer wheel, NULL if the element is not in the timer wheel */
 } hashtable_element_t;
 
+/**
+ * Hashtable locking modes
+ */
+typedef enum {
+    HASHTABLE_LOCK_MUTEX,  /**< All operations are serialized using a semaphore */
+    HASHTABLE_LOCK_RWLOCK, /**< Read-only operations share the hashtable, only modifications are serialized */
+    HASHTABLE_LOCK_RCU,    /**< Read-only operations take no lock, modifications are serialized and reclaimed once readers are done */
+} hashtable_lock_t;
+
+/**
+ * Hashtable hash functions
+ */
+typedef enum {
+    HASHTABLE_HASH_DJB2,    /**< djb2, processing one byte at a time, not seeded */
+    HASHTABLE_HASH_WYHASH,  /**< wyhash, fast non-cryptographic hash processing 8 bytes at a time */
+    HASHTABLE_HASH_SIPHASH, /**< SipHash-1-3, keyed hash resisting to collisions chosen by an attacker who does not know the seed */
+} hashtable_hash_t;
+
+/**
+ * Hashtable custom hash function
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param seed Seed of the hashtable
+ * @return Hash value of the key
+ */
+typedef uint64_t (*hashtable_hash_fct_t)(const void *key, size_t key_len, uint64_t seed);
+
+/**
+ * Hashtable scan function, called by hashtable_scan for each visited element
+ * @param key Key of the element, only valid during the call
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable
+ * @param user User data given to hashtable_scan
+ */
+typedef void (*hashtable_scan_fct_t)(const char *key, size_t key_len, void *e, void *user);
+
+/**
+ * Hashtable create function, called by hashtable_lookup_or_create and hashtable_get_or_load if the key is not found
+ * The function is called with the shard of the key locked by hashtable_lookup_or_create and must not use the hashtable in this case.
+ * The element belongs to the hashtable: in alloc mode it must be allocated with malloc and it is released with free once copied, or stored as is if its
+ * size is 0. If it is not added, because another thread has added the key while hashtable_get_or_load was loading it or on failure, it is released with
+ * free in alloc mode, or given to the evict function otherwise.
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param size Size of the element to be stored, copied in the hashtable in alloc mode
+ * @param user User data given to hashtable_lookup_or_create or hashtable_get_or_load
+ * @return Element to be added, NULL if it can not be created
+ */
+typedef void *(*hashtable_create_fct_t)(const void *key, size_t key_len, size_t *size, void *user);
+
+/**
+ * Hashtable evict function, called when an element is evicted because the capacity of the hashtable is reached
+ * The function is called with the shard of the key locked and must not use the hashtable, the element is given to the function.
+ * @param key Key of the element, only valid during the call
+ * @param key_len Length of the key in bytes
+ * @param e Element evicted from the hashtable
+ * @param user User data of the configuration of the hashtable
+ */
+typedef void (*hashtable_evict_fct_t)(const char *key, size_t key_len, void *e, void *user);
+
+/**
+ * Hashtable value function, called by hashtable_with_value with the element found
+ * The function is called with the shard of the key locked and must not use the hashtable, the element may be modified in place.
+ * @param key Key of the element, only valid during the call
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable
+ * @param size Size of the element
+ * @param user User data given to hashtable_with_value
+ */
+typedef void (*hashtable_value_fct_t)(const char *key, size_t key_len, void *e, size_t size, void *user);
+
+/**
+ * Hashtable compute actions, returned by the compute function
+ */
+typedef enum {
+    HASHTABLE_COMPUTE_KEEP,   /**< Keep the element unchanged, nothing is added if the key is not found */
+    HASHTABLE_COMPUTE_SET,    /**< Store the element given by the function, added or replacing the existing one */
+    HASHTABLE_COMPUTE_REMOVE, /**< Remove the element if the key is found */
+} hashtable_compute_t;
+
+/**
+ * Hashtable compute function, called by hashtable_compute with the element found or not
+ * The function is called with the shard of the key locked and must not use the hashtable.
+ * @param key Key of the element, only valid during the call
+ * @param key_len Length of the key in bytes
+ * @param found true if the key is found, false otherwise
+ * @param e Element of the hashtable if found, replaced by the element to be stored with HASHTABLE_COMPUTE_SET
+ * @param size Size of the element of the hashtable if found, replaced by the size of the element to be stored with HASHTABLE_COMPUTE_SET
+ * @param user User data given to hashtable_compute
+ * @return Action to be done on the element
+ */
+typedef hashtable_compute_t (*hashtable_compute_fct_t)(const char *key, size_t key_len, bool found, void **e, size_t *size, void *user);
+
+/**
+ * Hashtable pre-hashed key, initialized with hashtable_key_init
+ */
+typedef struct {
+    const void *key;     /**< Key of the element */
+    size_t      key_len; /**< Length of the key in bytes */
+    uint64_t    hash;    /**< Hash value of the key */
+    uint64_t    hash_id; /**< Identifier of the hash function used to compute the hash value */
+} hashtable_key_t;
+
+/**
+ * Hashtable configuration
+ */
+typedef struct {
+    size_t                size;       /**< Initial horizontal size of the hashtable, also used as minimum size when shrinking */
+    bool                  alloc;      /**< Flag to indicate if elements are allocated when they are added in the hashtable */
+    bool                  grow;       /**< Flag to indicate if the hashtable is grown when the load factor becomes too high */
+    bool                  shrink;     /**< Flag to indicate if the hashtable is shrunk when the load factor becomes too low */
+    hashtable_lock_t      lock;       /**< Locking mode of the hashtable */
+    size_t                shards;     /**< Number of shards of the hashtable, each shard being locked independently */
+    hashtable_hash_t      hash;       /**< Hash function of the keys */
+    hashtable_hash_fct_t  hash_fct;   /**< Custom hash function of the keys, used instead of hash if not NULL */
+    uint64_t              seed;       /**< Seed of the hash function, a random seed is chosen when the hashtable is created if 0 */
+    size_t                capacity;   /**< Maximum number of elements of the hashtable, shared between the shards, at least 1 per shard, 0 if not bounded */
+    size_t                memory;     /**< Maximum bytes of the elements with their keys, shared between the shards, at least 1 per shard, 0 if not bounded */
+    bool                  admission;  /**< Flag to indicate if new elements are only added if they are accessed more often than the elements they evict */
+    bool                  refcount;   /**< Flag to indicate if values are reference counted, values returned are then released with hashtable_value_release */
+    hashtable_evict_fct_t evict_fct;  /**< Function called with the evicted elements, owned values are released if NULL in alloc mode */
+    void *                evict_user; /**< User data given to the evict function */
+} hashtable_config_t;
+
+/**
+ * Hashtable table of lists of elements
+ */
+typedef struct {
+    size_t                size;  /**< Number of lists of elements, power of two */
+    hashtable_element_t **lists; /**< Lists of elements, allocated with the table */
+} hashtable_table_t;
+
+/**
+ * Hashtable retired memory block types
+ */
+typedef enum {
+    HASHTABLE_RETIRED_MEMORY,  /**< Memory block released with free */
+    HASHTABLE_RETIRED_ELEMENT, /**< Element released with its key, or its reference to the block in which it is allocated */
+    HASHTABLE_RETIRED_VALUE,   /**< Value owned by the hashtable, reference counted values are released with their last reference */
+} hashtable_retired_type_t;
+
+/**
+ * Hashtable retired memory block, released once no reader or snapshot may access it anymore
+ */
+typedef struct hashtable_retired_s {
+    struct hashtable_retired_s *next;     /**< Next retired memory block */
+    unsigned long               epoch;    /**< Epoch at which the memory block has been retired */
+    void *                      ptr;      /**< Retired memory block */
+    hashtable_retired_type_t    type;     /**< Type of the memory block */
+    uint64_t                    version;  /**< Version of the element when the value has been stored */
+    uint64_t                    replaced; /**< Version of the shard once the value has been replaced or removed, 0 if no snapshot references the value */
+} hashtable_retired_t;
+
+/**
+ * Hashtable history record, previous state of an element modified or removed while snapshots of its shard are pending
+ */
+typedef struct hashtable_history_s {
+    struct hashtable_history_s *next;     /**< Next history record of the shard */
+    hashtable_element_t *       element;  /**< Element of the hashtable, its key is not released while snapshots of the shard are pending */
+    void *                      e;        /**< Element itself before the modification, with its own reference if values are reference counted */
+    int64_t                     counter;  /**< Value of the counter before the modification, pointed by e if the element is a counter */
+    uint64_t                    version;  /**< Version of the element before the modification */
+    uint64_t                    replaced; /**< Version of the shard once the element has been modified or removed */
+} hashtable_history_t;
+
+/**
+ * Hashtable snapshot cut, last version of a shard included in a snapshot
+ */
+typedef struct hashtable_cut_s {
+    struct hashtable_cut_s *next;    /**< Next cut of the shard */
+    uint64_t                version; /**< Last version of the shard included in the snapshot, UINT64_MAX until the versions of all shards are read */
+    bool                    pending; /**< Flag set until the elements of the shard are stored in the snapshot */
+} hashtable_cut_t;
+
+/**
+ * Hashtable reference counted value header, allocated right before the values when the configuration enables refcount
+ */
+typedef union {
+    size_t      refs;  /**< Number of references to the value, including the one of the hashtable while the value is stored */
+    max_align_t align; /**< Alignment of the value following the header */
+} hashtable_value_t;
+
+/**
+ * Hashtable reader slot, counting the readers which entered each parity of epoch (HASHTABLE_LOCK_RCU)
+ */
+typedef struct {
+    unsigned long active[2];                                                      /**< Number of readers in even and odd epochs */
+    char          padding[HASHTABLE_EPOCH_SLOT_SIZE - 2 * sizeof(unsigned long)]; /**< Padding to avoid sharing cache lines between slots */
+} hashtable_epoch_slot_t;
+
+/**
+ * Hashtable load in progress, so that concurrent hashtable_get_or_load calls missing the same key wait for a single loader
+ */
+typedef struct hashtable_load_s {
+    struct hashtable_load_s *next;    /**< Next load in progress in the shard */
+    const void *             key;     /**< Key of the element being loaded */
+    size_t                   key_len; /**< Length of the key in bytes */
+    uint64_t                 hash;    /**< Hash value of the key */
+    bool                     done;    /**< Flag set once the element has been loaded and added */
+    void *                   e;       /**< Element of the hashtable once loaded, NULL if it can not be loaded */
+    size_t                   waiters; /**< Number of threads waiting for the load */
+    pthread_cond_t           cond;    /**< Condition signaled once the element has been loaded */
+} hashtable_load_t;
+
+/**
+ * Hashtable hierarchical timer wheel, elements are stored in the slot of the level matching the time remaining before their expiration
+ * and moved to the lower levels as the time passes, so that only the elements which expire are processed.
+ */
+typedef struct {
+    uint64_t             now;                                                      /**< Last tick processed, in milliseconds of the monotonic clock */
+    uint64_t             bitmap[HASHTABLE_WHEEL_LEVELS];                           /**< Masks of the slots of each level which are not empty */
+    hashtable_element_t *slots[HASHTABLE_WHEEL_LEVELS][1 << HASHTABLE_WHEEL_BITS]; /**< Lists of elements of the slots of each level */
+} hashtable_wheel_t;
+
+/**
+ * Hashtable frequency sketch, count-min sketch of the accesses to the keys of a shard used to admit new elements
+ * Counters are halved once the number of accesses recorded reaches HASHTABLE_SKETCH_AGING times the size of a row, so that old accesses fade out.
+ */
+typedef struct {
+    size_t   size;     /**< Number of counters of each row, power of two */
+    size_t   count;    /**< Number of accesses recorded since the counters have been halved */
+    uint8_t *counters; /**< Counters of the rows, allocated with the sketch */
+} hashtable_sketch_t;
+
+/**
+ * Hashtable shard
+ * When the shard is resized, elements are progressively migrated from table[0] to table[1]
+ * by the next operations, table[1] then replaces table[0] when the migration is completed.
+ */
+typedef struct {
+    hashtable_table_t *  table[2];      /**< Tables of lists of elements, table[1] is only used during rehash */
+    size_t               rehash;        /**< Index of the next list of elements of table[0] to be migrated */
+    size_t               count;         /**< Number of elements in the shard */
+    size_t               bytes;         /**< Number of bytes used by the elements of the shard, with their keys and their values */
+    size_t               capacity;      /**< Maximum number of elements of the shard, 0 if not bounded */
+    size_t               memory;        /**< Maximum number of bytes used by the elements of the shard, 0 if not bounded */
+    size_t               hand;          /**< Position of the clock hand selecting the elements to be evicted */
+    unsigned long        generation;    /**< Generation of the shard, incremented each time an element is removed */
+    uint64_t             version;       /**< Last version given to an element of the shard */
+    unsigned int         seq;           /**< Sequence counter, odd while elements are migrated (HASHTABLE_LOCK_RCU) */
+    hashtable_retired_t *retired;       /**< List of retired memory blocks, oldest first (HASHTABLE_LOCK_RCU or snapshots) */
+    hashtable_retired_t *retired_tail;  /**< Last retired memory block (HASHTABLE_LOCK_RCU or snapshots) */
+    size_t               retired_count; /**< Number of retired memory blocks (HASHTABLE_LOCK_RCU or snapshots) */
+    hashtable_retired_t *spare;         /**< List of retired memory blocks allocated in advance, so that elements can be retired while snapshots exist */
+    size_t               spare_count;   /**< Number of retired memory blocks allocated in advance */
+    hashtable_retired_t *pinned;        /**< List of retired elements and values still referenced by snapshots, checked again when a snapshot is done */
+    hashtable_cut_t *    cuts;          /**< Cuts of the snapshots not released yet */
+    size_t               pending;       /**< Number of snapshots whose elements of the shard are not stored yet, modifications are recorded meanwhile */
+    hashtable_history_t *history;       /**< History records of the elements modified or removed while snapshots of the shard are pending */
+    hashtable_history_t *history_spare; /**< History record allocated in advance, so that elements can be modified while snapshots are pending */
+    sem_t                sem;           /**< Semaphore used to protect the access to the shard (HASHTABLE_LOCK_MUTEX and HASHTABLE_LOCK_RCU) */
+    pthread_rwlock_t     rwlock;        /**< Read-write lock used to protect the access to the shard (HASHTABLE_LOCK_RWLOCK) */
+    hashtable_wheel_t *  wheel;         /**< Timer wheel of the elements which expire, allocated when the first one is added */
+    hashtable_sketch_t * sketch;        /**< Frequency sketch of the accesses to the keys of the shard, NULL if new elements are always admitted */
+    hashtable_load_t *   loads;         /**< List of loads in progress in the shard */
+    pthread_mutex_t      loads_mutex;   /**< Mutex used to protect the list of loads in progress, which are not protected by the lock of the shard */
+} hashtable_shard_t;
+
+/**
+ * Hashtable entry, returned by hashtable_find to update or remove an element without looking it up again
+ * The entry is not valid anymore once an element of its shard has been removed, which is detected using the generation.
+ * If values are reference counted, the reference of the entry is released by hashtable_entry_remove, or with hashtable_value_release otherwise.
+ */
+typedef struct {
+    hashtable_element_t *element;    /**< Element of the hashtable, NULL if not found */
+    hashtable_shard_t *  shard;      /**< Shard of the element */
+    unsigned long        generation; /**< Generation of the shard when the element has been found */
+    void *               e;          /**< Element itself when the element has been found or updated, a reference if values are reference counted */
+} hashtable_entry_t;
+
 /**
  * Hashtable instance
+ * Keys are partitioned by hash value across independently locked shards.
  */
 typedef struct {
-    hashtable_element_t **table; /**< Table of lists of elements */
-    size_t                size;  /**< Size of the table of lists of elements */
-    size_t                count; /**< Number of elements in the hashtable */
-    bool                  alloc; /**< Flag to indicate if elements are allocated when they are added in the hashtable */
-    sem_t                 sem;   /**< Semaphore used to protect the access to the hashtable */
+    hashtable_shard_t *     shards;     /**< Shards of the hashtable */
+    size_t                  shard_size; /**< Initial horizontal size of each shard, also used as minimum size when shrinking */
+    unsigned long           epoch;      /**< Current epoch (HASHTABLE_LOCK_RCU) */
+    hashtable_epoch_slot_t *slots;      /**< Reader slots (HASHTABLE_LOCK_RCU) */
+    uint64_t                seed[2];    /**< Keys of the hash function, seed[0] is given to custom hash functions */
+    uint64_t                hash_id;    /**< Identifier of the hash function and its keys, used to check pre-hashed keys */
+    hashtable_config_t      config;     /**< Configuration of the hashtable */
 } hashtable_t;
 
+/**
+ * Hashtable snapshot item
+ */
+typedef struct {
+    const char *key;     /**< Key of the element, copied by the snapshot and followed by a NUL character */
+    size_t      key_len; /**< Length of the key in bytes */
+    void *      e;       /**< Element itself when the snapshot has been taken, counters are copied by the snapshot */
+} hashtable_snapshot_item_t;
+
+/**
+ * Hashtable snapshot, point-in-time view of the hashtable returned by hashtable_snapshot
+ */
+typedef struct {
+    hashtable_t *              hashtable; /**< Hashtable instance */
+    size_t                     count;     /**< Number of elements of the snapshot */
+    hashtable_snapshot_item_t *items;     /**< Elements of the snapshot */
+    hashtable_cut_t *          cuts;      /**< Cuts of the shards, allocated with the snapshot */
+    char **                    keys;      /**< Counters and keys copied from each shard, allocated with the snapshot */
+} hashtable_snapshot_t;
+
+/**
+ * Hashtable snapshot cursor, used while the elements of a shard are stored in a snapshot
+ */
+typedef struct {
+    hashtable_snapshot_t *snapshot; /**< Snapshot of the hashtable */
+    uint64_t              version;  /**< Last version of the shard included in the snapshot */
+    size_t                count;    /**< Number of elements of the shard included in the snapshot */
+    size_t                counters; /**< Number of counters of the shard included in the snapshot */
+    size_t                bytes;    /**< Number of bytes of the keys of the shard included in the snapshot, with their NUL characters */
+    int64_t *             counter;  /**< Position of the next counter copied, NULL while the elements are counted */
+    char *                key;      /**< Position of the next key copied, NULL while the elements are counted */
+} hashtable_snapshot_cursor_t;
+
 /******************************************************************************/
 /* Prototypes                                                                 */
 /******************************************************************************/
@@ -127,16 +522,359 @@ typedef struct {
  */
 HASHTABLE_PUBLIC(hashtable_t *) hashtable_create(size_t size, bool alloc);
 
+/**
+ * @brief Initialize hashtable configuration with default values
+ * @param config Hashtable configuration
+ */
+HASHTABLE_PUBLIC(void) hashtable_config_init(hashtable_config_t *config);
+
+/**
+ * @brief Function used to create hashtable instance with a specific configuration
+ * @param config Hashtable configuration
+ * @return Hashtable instance if the function succeeded, NULL otherwise
+ */
+HASHTABLE_PUBLIC(hashtable_t *) hashtable_create_with_config(hashtable_config_t *config);
+
+/**
+ * @brief Initialize pre-hashed key, which can be used with all hashtables sharing the same hash function and seed
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key
+ * @param key Key of the element, binary data which is not required to be NUL-terminated, must remain valid while the pre-hashed key is used
+ * @param key_len Length of the key in bytes
+ */
+HASHTABLE_PUBLIC(void) hashtable_key_init(hashtable_t *hashtable, hashtable_key_t *hk, const void *key, size_t key_len);
+
 /**
  * @brief Add element to the hashtable
  * @param hashtable Hashtable instance
  * @param key Key of the element to be added
  * @param e Element to be added in the hashtable
  * @param size Size of the element to be added
- * @return 0 if the function succeeded, -1 otherwise
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
  */
 HASHTABLE_PUBLIC(int) hashtable_add(hashtable_t *hashtable, char *key, void *e, size_t size);
 
+/**
+ * @brief Add element to the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size);
+
+/**
+ * @brief Add element to the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element to be added, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size);
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_ttl(hashtable_t *hashtable, char *key, void *e, size_t size, uint64_t ttl);
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_ttl_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, uint64_t ttl);
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element to be added, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_ttl_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, uint64_t ttl);
+
+/**
+ * @brief Add several elements to the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements to be added
+ * @param values Elements to be added in the hashtable
+ * @param sizes Sizes of the elements to be added, NULL if all sizes are 0
+ * @param n Number of elements to be added
+ * @param unique true if the keys are known to be unique and not present in the hashtable, the existing elements are not looked up
+ * @return 0 if the function succeeded, 1 if some elements are not admitted, -1 otherwise, elements added before the failure remain in the hashtable
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_bulk(hashtable_t *hashtable, char **keys, void **values, size_t *sizes, size_t n, bool unique);
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * With admission and refcount, the element added is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_add(hashtable_t *hashtable, char *key, void *e, size_t size);
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * With admission and refcount, the element added is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_add_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size);
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * With admission and refcount, the element added is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_add_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size);
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * With admission and refcount, the element created is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_create(hashtable_t *hashtable, char *key, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * With admission and refcount, the element created is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_create_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * With admission and refcount, the element created is only stored if it is admitted, otherwise a reference to a copy which is not stored is returned.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_or_create_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_replace(hashtable_t *hashtable, char *key, void *e, size_t size, void **prev);
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_replace_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, void **prev);
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_replace_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, void **prev);
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is given a private copy which replaces the value if it is modified.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_compute(hashtable_t *hashtable, char *key, hashtable_compute_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is given a private copy which replaces the value if it is modified.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_compute_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_compute_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is given a private copy which replaces the value if it is modified.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+HASHTABLE_PUBLIC(int) hashtable_compute_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_compute_fct_t fct, void *user);
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_if_version(hashtable_t *hashtable, char *key, void *e, size_t size, uint64_t version);
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_if_version_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, uint64_t version);
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_add_if_version_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, uint64_t version);
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * The counter is stored in the element of the hashtable, hashtable_lookup returns a pointer to its int64_t value.
+ * @param hashtable Hashtable instance
+ * @param key Key of the counter
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_incr(hashtable_t *hashtable, char *key, int64_t delta, int64_t *value);
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * The counter is stored in the element of the hashtable, hashtable_lookup returns a pointer to its int64_t value.
+ * @param hashtable Hashtable instance
+ * @param key Key of the counter, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_incr_n(hashtable_t *hashtable, const void *key, size_t key_len, int64_t delta, int64_t *value);
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * The counter is stored in the element of the hashtable, hashtable_lookup returns a pointer to its int64_t value.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the counter, initialized with hashtable_key_init
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_incr_hk(hashtable_t *hashtable, hashtable_key_t *hk, int64_t delta, int64_t *value);
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * The loader is called without locking the shard, and concurrent calls missing the same key wait for it instead of loading the element again.
+ * With admission and refcount, the element loaded is only added if it is admitted, otherwise the callers get references to a copy which is not stored.
+ * Without refcount, the element loaded is always admitted: the callers could not tell an element which is not stored and must be released from an
+ * element of the hashtable, and in reference mode the rejected element would be given to the evict function while being returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_get_or_load(hashtable_t *hashtable, char *key, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * The loader is called without locking the shard, and concurrent calls missing the same key wait for it instead of loading the element again.
+ * With admission and refcount, the element loaded is only added if it is admitted, otherwise the callers get references to a copy which is not stored.
+ * Without refcount, the element loaded is always admitted: the callers could not tell an element which is not stored and must be released from an
+ * element of the hashtable, and in reference mode the rejected element would be given to the evict function while being returned.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_get_or_load_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * The loader is called without locking the shard, and concurrent calls missing the same key wait for it instead of loading the element again.
+ * With admission and refcount, the element loaded is only added if it is admitted, otherwise the callers get references to a copy which is not stored.
+ * Without refcount, the element loaded is always admitted: the callers could not tell an element which is not stored and must be released from an
+ * element of the hashtable, and in reference mode the rejected element would be given to the evict function while being returned.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+HASHTABLE_PUBLIC(void *) hashtable_get_or_load_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_create_fct_t fct, void *user);
+
+/**
+ * @brief Remove the elements of the hashtable which have expired, elements are also removed when a shard is modified
+ * @param hashtable Hashtable instance
+ * @return Number of elements removed
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_expire(hashtable_t *hashtable);
+
 /**
  * @brief Get number of element in the hashtable
  * @param hashtable Hashtable instance
@@ -144,6 +882,13 @@ HASHTABLE_PUBLIC(int) hashtable_add(hashtable_t *hashtable, char *key, void *e,
  */
 HASHTABLE_PUBLIC(size_t) hashtable_get_count(hashtable_t *hashtable);
 
+/**
+ * @brief Get number of bytes used by the elements of the hashtable
+ * @param hashtable Hashtable instance
+ * @return Number of bytes used by the elements, with their keys and their values
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_get_memory(hashtable_t *hashtable);
+
 /**
  * @brief Check if key is present in the hashtable
  * @param hashtable Hashtable instance
@@ -152,6 +897,23 @@ HASHTABLE_PUBLIC(size_t) hashtable_get_count(hashtable_t *hashtable);
  */
 HASHTABLE_PUBLIC(bool) hashtable_has_key(hashtable_t *hashtable, char *key);
 
+/**
+ * @brief Check if key is present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return true if the key is found, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_has_key_n(hashtable_t *hashtable, const void *key, size_t key_len);
+
+/**
+ * @brief Check if key is present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return true if the key is found, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_has_key_hk(hashtable_t *hashtable, hashtable_key_t *hk);
+
 /**
  * @brief Get all keys of the hashtable
  * @param hashtable Hashtable instance
@@ -160,6 +922,55 @@ HASHTABLE_PUBLIC(bool) hashtable_has_key(hashtable_t *hashtable, char *key);
  */
 HASHTABLE_PUBLIC(size_t) hashtable_get_keys(hashtable_t *hashtable, char ***keys);
 
+/**
+ * @brief Visit a bounded number of buckets of the hashtable, starting at the wanted cursor
+ * Each call locks a single shard at a time. Elements present during the whole scan are visited at least once, even if the
+ * hashtable is resized between two calls, and may be visited more than once. The function must not use the hashtable.
+ * @param hashtable Hashtable instance
+ * @param cursor Cursor returned by the previous call, 0 to start a new scan
+ * @param count Number of buckets to visit, at least one
+ * @param fct Function called for each element of the visited buckets
+ * @param user User data given to the function
+ * @return Cursor to use for the next call, 0 if the scan is completed
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_scan(hashtable_t *hashtable, size_t cursor, size_t count, hashtable_scan_fct_t fct, void *user);
+
+/**
+ * @brief Take a point-in-time view of the hashtable, which can be parsed while the hashtable is modified
+ * All shards are locked together only to read their versions, then the elements of each shard are stored with its lock only, keys and counters being
+ * copied. Elements modified or removed after the versions are read are stored as they were from history records. In alloc mode without refcount,
+ * values included in the view are not released by the hashtable until the snapshot is released, values removed, replaced or evicted meanwhile are
+ * given to the caller as copies, which can be released right away. In reference mode, values belong to the caller and must not be released or
+ * modified while a snapshot may reference them.
+ * @param hashtable Hashtable instance
+ * @return Snapshot of the hashtable if the function succeeded, NULL otherwise
+ */
+HASHTABLE_PUBLIC(hashtable_snapshot_t *) hashtable_snapshot(hashtable_t *hashtable);
+
+/**
+ * @brief Get number of elements of the snapshot
+ * @param snapshot Snapshot of the hashtable
+ * @return Number of elements of the snapshot
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_snapshot_get_count(hashtable_snapshot_t *snapshot);
+
+/**
+ * @brief Get element of the snapshot
+ * @param snapshot Snapshot of the hashtable
+ * @param index Index of the element, lower than the number of elements of the snapshot
+ * @param key Key of the element, valid until the snapshot is released, may be NULL
+ * @param key_len Length of the key in bytes, may be NULL
+ * @param e Element itself when the snapshot has been taken, may be NULL
+ * @return true if the element exists, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_snapshot_get(hashtable_snapshot_t *snapshot, size_t index, const char **key, size_t *key_len, void **e);
+
+/**
+ * @brief Release snapshot of the hashtable, it must be released before the hashtable
+ * @param snapshot Snapshot of the hashtable
+ */
+HASHTABLE_PUBLIC(void) hashtable_snapshot_release(hashtable_snapshot_t *snapshot);
+
 /**
  * @brief Lookup element of the hashtable
  * @param hashtable Hashtable instance
@@ -168,14 +979,221 @@ HASHTABLE_PUBLIC(size_t) hashtable_get_keys(hashtable_t *hashtable, char ***keys
  */
 HASHTABLE_PUBLIC(void *) hashtable_lookup(hashtable_t *hashtable, char *key);
 
+/**
+ * @brief Lookup element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return Element of the hashtable, NULL if not found
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_n(hashtable_t *hashtable, const void *key, size_t key_len);
+
+/**
+ * @brief Lookup element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return Element of the hashtable, NULL if not found
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_hk(hashtable_t *hashtable, hashtable_key_t *hk);
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+HASHTABLE_PUBLIC(int) hashtable_lookup_copy(hashtable_t *hashtable, char *key, void *buf, size_t buflen, size_t *size);
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+HASHTABLE_PUBLIC(int) hashtable_lookup_copy_n(hashtable_t *hashtable, const void *key, size_t key_len, void *buf, size_t buflen, size_t *size);
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+HASHTABLE_PUBLIC(int) hashtable_lookup_copy_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *buf, size_t buflen, size_t *size);
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is called with a private copy which then replaces the value.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+HASHTABLE_PUBLIC(int) hashtable_with_value(hashtable_t *hashtable, char *key, hashtable_value_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is called with a private copy which then replaces the value.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+HASHTABLE_PUBLIC(int) hashtable_with_value_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_value_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * In alloc mode, if a snapshot includes the value, the function is called with a private copy which then replaces the value.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+HASHTABLE_PUBLIC(int) hashtable_with_value_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_value_fct_t fct, void *user);
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_versioned(hashtable_t *hashtable, char *key, uint64_t *version);
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_versioned_n(hashtable_t *hashtable, const void *key, size_t key_len, uint64_t *version);
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+HASHTABLE_PUBLIC(void *) hashtable_lookup_versioned_hk(hashtable_t *hashtable, hashtable_key_t *hk, uint64_t *version);
+
+/**
+ * @brief Lookup several elements of the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param values Elements of the hashtable, NULL if not found
+ * @return Number of keys found in the hashtable
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_lookup_batch(hashtable_t *hashtable, char **keys, size_t n, void **values);
+
+/**
+ * @brief Check if several keys are present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param bitmap Bitmap of the keys found in the hashtable, bit N % 8 of byte N / 8 being set if keys[N] is found
+ * @return Number of keys found in the hashtable
+ */
+HASHTABLE_PUBLIC(size_t) hashtable_has_key_batch(hashtable_t *hashtable, char **keys, size_t n, uint8_t *bitmap);
+
 /**
  * @brief Remove element of the hashtable
+ * In alloc mode without refcount, the element returned while a snapshot includes it is a copy, the element of the snapshot is released with it.
  * @param hashtable Hashtable instance
  * @param key Key of the element
- * @return Head element of the hashtable, NULL if not found
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
  */
 HASHTABLE_PUBLIC(void *) hashtable_remove(hashtable_t *hashtable, char *key);
 
+/**
+ * @brief Remove element of the hashtable
+ * In alloc mode without refcount, the element returned while a snapshot includes it is a copy, the element of the snapshot is released with it.
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
+ */
+HASHTABLE_PUBLIC(void *) hashtable_remove_n(hashtable_t *hashtable, const void *key, size_t key_len);
+
+/**
+ * @brief Remove element of the hashtable
+ * In alloc mode without refcount, the element returned while a snapshot includes it is a copy, the element of the snapshot is released with it.
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
+ */
+HASHTABLE_PUBLIC(void *) hashtable_remove_hk(hashtable_t *hashtable, hashtable_key_t *hk);
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_find(hashtable_t *hashtable, char *key, hashtable_entry_t *entry);
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_find_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_entry_t *entry);
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+HASHTABLE_PUBLIC(bool) hashtable_find_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_entry_t *entry);
+
+/**
+ * @brief Replace the element of an entry
+ * @param hashtable Hashtable instance
+ * @param entry Entry of the element, returned by hashtable_find
+ * @param e Element to be stored in the hashtable
+ * @param size Size of the element to be stored
+ * @return 0 if the function succeeded, -1 if the entry is not valid anymore or if memory can not be allocated
+ */
+HASHTABLE_PUBLIC(int) hashtable_entry_set_value(hashtable_t *hashtable, hashtable_entry_t *entry, void *e, size_t size);
+
+/**
+ * @brief Remove the element of an entry
+ * @param hashtable Hashtable instance
+ * @param entry Entry of the element, returned by hashtable_find, it is not valid anymore and its reference to the value is released in any case
+ * @param e Element removed from the hashtable, may be NULL in which case the element is released in alloc mode
+ * @return 0 if the function succeeded, -1 if the entry is not valid anymore or if memory can not be allocated while snapshots exist
+ */
+HASHTABLE_PUBLIC(int) hashtable_entry_remove(hashtable_t *hashtable, hashtable_entry_t *entry, void **e);
+
+/**
+ * @brief Release a value returned by the hashtable, the value is released with its last reference if values are reference counted
+ * @param hashtable Hashtable instance
+ * @param e Value returned by the hashtable, may be NULL
+ */
+HASHTABLE_PUBLIC(void) hashtable_value_release(hashtable_t *hashtable, void *e);
+
 /**
  * @brief Release hashtable instance
  * @param hashtable Hashtable instance
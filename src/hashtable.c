@@ -34,399 +34,5467 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sched.h>
+#include <time.h>
 
 #include "hashtable.h"
 
+/******************************************************************************/
+/* Variables                                                                  */
+/******************************************************************************/
+
+static __thread size_t hashtable_epoch_slot  = (size_t)-1;                /**< Reader slot of the current thread (HASHTABLE_LOCK_RCU) */
+static pthread_once_t  hashtable_epoch_once  = PTHREAD_ONCE_INIT;         /**< Creation of the key releasing the reader slots (HASHTABLE_LOCK_RCU) */
+static pthread_key_t   hashtable_epoch_key;                               /**< Key releasing the reader slot of a thread at exit (HASHTABLE_LOCK_RCU) */
+static pthread_mutex_t hashtable_epoch_mutex = PTHREAD_MUTEX_INITIALIZER; /**< Mutex protecting the numbers of threads of the slots (HASHTABLE_LOCK_RCU) */
+static size_t          hashtable_epoch_users[HASHTABLE_EPOCH_SLOTS];      /**< Number of threads using each reader slot (HASHTABLE_LOCK_RCU) */
+
 /******************************************************************************/
 /* Prototypes                                                                 */
 /******************************************************************************/
 
 /**
- * @brief Compute hash value of the wanted key
+ * @brief Initialize the keys of the hash function, from the configured seed or from a random source
+ * @param hashtable Hashtable instance
+ */
+static void hashtable_init_seed(hashtable_t *hashtable);
+
+/**
+ * @brief Compute hash value of the wanted key with the hash function of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @return Hash value of the key
+ */
+static uint64_t hashtable_compute_hash(hashtable_t *hashtable, const void *key, size_t key_len);
+
+/**
+ * @brief Get hash value of the pre-hashed key, which is computed again if the key has been hashed with another hash function
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key
+ * @return Hash value of the key
+ */
+static uint64_t hashtable_key_hash(hashtable_t *hashtable, hashtable_key_t *hk);
+
+/**
+ * @brief Compute djb2 hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @return Hash value of the key
+ */
+static uint64_t hashtable_hash_djb2(const void *key, size_t key_len);
+
+/**
+ * @brief Read up to 8 bytes of the key as an integer
+ * @param p Bytes of the key
+ * @param len Number of bytes to be read
+ * @return Integer value
+ */
+static uint64_t hashtable_hash_read(const uint8_t *p, size_t len);
+
+/**
+ * @brief Multiply two 64 bits integers, the 128 bits result is split between the two integers
+ * @param a First integer, replaced by the lowest 64 bits of the result
+ * @param b Second integer, replaced by the highest 64 bits of the result
+ */
+static void hashtable_hash_mum(uint64_t *a, uint64_t *b);
+
+/**
+ * @brief Compute wyhash hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param seed Seed of the hash function
+ * @return Hash value of the key
+ */
+static uint64_t hashtable_hash_wyhash(const void *key, size_t key_len, uint64_t seed);
+
+/**
+ * @brief Perform SipHash rounds on the internal state
+ * @param v Internal state
+ * @param rounds Number of rounds
+ */
+static void hashtable_hash_sipround(uint64_t v[4], int rounds);
+
+/**
+ * @brief Compute SipHash-1-3 hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param k0 First half of the 128 bits key of the hash function
+ * @param k1 Second half of the 128 bits key of the hash function
+ * @return Hash value of the key
+ */
+static uint64_t hashtable_hash_siphash(const void *key, size_t key_len, uint64_t k0, uint64_t k1);
+
+/**
+ * @brief Get the shard in which the wanted hash value is stored
+ * @param hashtable Hashtable instance
+ * @param hash Hash value of the key
+ * @return Shard of the hashtable
+ */
+static hashtable_shard_t *hashtable_get_shard(hashtable_t *hashtable, uint64_t hash);
+
+/**
+ * @brief Get the size of the memory allocated for an element and its key
+ * @param key_len Length of the key in bytes
+ * @return Size of the element, multiple of 8 bytes so that elements can be allocated contiguously
+ */
+static size_t hashtable_element_size(size_t key_len);
+
+/**
+ * @brief Get the number of bytes used by an element, accounted in the memory of its shard
+ * @param element Element of the hashtable
+ * @return Size of the element with its key, plus the size of its value
+ */
+static size_t hashtable_element_bytes(hashtable_element_t *element);
+
+/**
+ * @brief Initialize element in the wanted memory, the key is copied right after the element
+ * @param hashtable Hashtable instance
+ * @param ptr Memory of the element, at least hashtable_element_size bytes
+ * @param block Block in which the element is allocated, NULL if the element is allocated alone
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element if the function succeeded, NULL otherwise
+ */
+static hashtable_element_t *hashtable_element_init(hashtable_t *hashtable, void *ptr, hashtable_block_t *block, const void *key, size_t key_len, uint64_t hash,
+                                                   void *e, size_t size);
+
+/**
+ * @brief Get the counter stored in the element, allocated right after its key by hashtable_incr
+ * @param element Element of the hashtable
+ * @return Counter of the element, NULL if the element is not a counter
+ */
+static int64_t *hashtable_element_counter(hashtable_element_t *element);
+
+/**
+ * @brief Get the value of the element which can be given to the caller, counters are released with their element
+ * @param element Element of the hashtable
+ * @return Value of the element, NULL if the element is a counter
+ */
+static void *hashtable_element_value(hashtable_element_t *element);
+
+/**
+ * @brief Release memory of the element and its key, the value of the element is not released
+ * @param element Element of the hashtable
+ */
+static void hashtable_element_free(hashtable_element_t *element);
+
+/**
+ * @brief Release a reference to a block of elements, the block is released with its last reference
+ * @param block Block of elements
+ */
+static void hashtable_block_release(hashtable_block_t *block);
+
+/**
+ * @brief Copy a value to be stored in the hashtable in alloc mode, reference counted values are allocated after their header
+ * @param hashtable Hashtable instance
+ * @param e Value to be stored
+ * @param size Size of the value
+ * @return Value to be stored, which is e itself if it is not copied, NULL if memory can not be allocated
+ */
+static void *hashtable_value_copy(hashtable_t *hashtable, void *e, size_t size);
+
+/**
+ * @brief Get the value of an element to be returned to the caller, a reference is taken if values are reference counted
+ * @param hashtable Hashtable instance
+ * @param element Element of the hashtable, found while the shard is locked or in the current epoch
+ * @return Value of the element
+ */
+static void *hashtable_value_get(hashtable_t *hashtable, hashtable_element_t *element);
+
+/**
+ * @brief Release a value owned by the hashtable or a reference to it, which can not be accessed by readers anymore
+ * @param hashtable Hashtable instance
+ * @param e Value to be released
+ */
+static void hashtable_value_put(hashtable_t *hashtable, void *e);
+
+/**
+ * @brief Copy the value of an element in advance if it is referenced by snapshots, so that the value given to the caller once the element is removed or
+ * replaced can be released by the caller while the snapshots still access the stored one
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable, may be NULL
+ * @param copy Copy of the value, NULL if the value does not need to be copied
+ * @return 0 if the function succeeded, -1 if memory can not be allocated
+ */
+static int hashtable_value_detach_copy(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, void **copy);
+
+/**
+ * @brief Check if the value of an element may be included in a snapshot, in which case it must not be modified in place
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable
+ * @return true if the value may be included in a snapshot, false otherwise
+ */
+static bool hashtable_value_shared(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element);
+
+/**
+ * @brief Give a value removed or replaced to the caller, the reference of the hashtable is released after lock-free readers are done
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param e Value removed or replaced, may be NULL
+ * @param version Version of the element when the value has been stored
+ * @param copy Copy of the value given instead while snapshots reference it, returned by hashtable_value_detach_copy, may be NULL
+ * @return Value given to the caller, with its own reference if values are reference counted
+ */
+static void *hashtable_value_detach(hashtable_t *hashtable, hashtable_shard_t *shard, void *e, uint64_t version, void *copy);
+
+/**
+ * @brief Replace the value of an existing element
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable
+ * @param e New element to be stored in the hashtable
+ * @param size Size of the new element
+ * @param prev Previous element, given to the caller instead of being released, may be NULL
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int hashtable_update(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, void *e, size_t size, void **prev);
+
+/**
+ * @brief Give a new version to the element once it has been modified, readers seeing the new version also see the new value
+ * @param shard Shard of the hashtable
+ * @param element Element of the hashtable
+ */
+static void hashtable_element_version(hashtable_shard_t *shard, hashtable_element_t *element);
+
+/**
+ * @brief Create new element and insert it in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param hk Pre-hashed key of the element
+ * @param hash Hash value of the key
+ * @param e Element to be stored in the hashtable
+ * @param size Size of the element to be stored
+ * @param counter Initial value of the counter stored in the element instead of e, NULL if the element is not a counter
+ * @return Element of the shard if the function succeeded, NULL otherwise
+ */
+static hashtable_element_t *hashtable_add_element(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_key_t *hk, uint64_t hash, void *e, size_t size,
+                                                  int64_t *counter);
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found, used by hashtable_lookup_or_add, hashtable_lookup_or_create and hashtable_get_or_load
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element
+ * @param e Element to be added in the hashtable, used if fct is NULL
+ * @param size Size of the element to be added, used if fct is NULL
+ * @param owned true if the element given or created belongs to the hashtable, it is then released once copied in alloc mode or if it is not added
+ * @param fct Function creating the element to be added, may be NULL
+ * @param user User data given to the function
+ * @param admit true to submit the element to the admission of the shard, the element is then returned without being stored if it is rejected, only
+ * possible if values are reference counted
+ * @return Element of the hashtable, NULL if it can not be added
+ */
+static void *hashtable_lookup_or_add_element(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, bool owned, hashtable_create_fct_t fct,
+                                             void *user, bool admit);
+
+/**
+ * @brief Resize the shard at once so that the wanted number of elements can be stored without resizing it again
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param count Number of elements
+ */
+static void hashtable_reserve(hashtable_t *hashtable, hashtable_shard_t *shard, size_t count);
+
+/**
+ * @brief Lookup for the element with the wanted key in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element of the shard, NULL if not found
+ */
+static hashtable_element_t *hashtable_search(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash);
+
+/**
+ * @brief Insert new element in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param element Element to be inserted
+ * @param hash Hash value of the key of the element
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int hashtable_insert(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, uint64_t hash);
+
+/**
+ * @brief Unlink the element with the wanted key from the shard, the element is not released and entries of the shard become invalid
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element unlinked from the shard, NULL if not found
+ */
+static hashtable_element_t *hashtable_unlink(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash);
+
+/**
+ * @brief Evict elements of the shard until an element can be added or grown without exceeding its capacity and its memory
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param bytes Number of bytes to be added to the shard
+ * @param keep Element of the shard which is grown and must not be evicted, NULL if a new element is added
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int hashtable_make_room(hashtable_t *hashtable, hashtable_shard_t *shard, size_t bytes, hashtable_element_t *keep);
+
+/**
+ * @brief Select the element of the shard to be evicted, elements accessed since the clock hand passed them are given a second chance
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing, which is not empty
+ * @param keep Element of the shard which must not be selected, may be NULL
+ * @param peek true to only get the element which would be selected, without moving the clock hand nor clearing the flags of the elements
+ * @return Element to be evicted
+ */
+static hashtable_element_t *hashtable_victim(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *keep, bool peek);
+
+/**
+ * @brief Check if a new element is admitted in the shard, the element is compared with the element it would evict, which is evicted if it is admitted
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param hash Hash value of the key of the new element
+ * @param bytes Number of bytes used by the new element
+ * @return 0 if the element can be added, 1 if its key is estimated to be accessed less often than the key of the element it would evict, -1 otherwise
+ */
+static int hashtable_admit(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t hash, size_t bytes);
+
+/**
+ * @brief Discard a new element which has not been admitted, as if it had been added and evicted right away
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element which has not been added, given to the evict function in reference mode
+ */
+static void hashtable_reject(hashtable_t *hashtable, const void *key, size_t key_len, void *e);
+
+/**
+ * @brief Create a frequency sketch
+ * @param size Number of counters of each row, power of two
+ * @return Frequency sketch if the function succeeded, NULL otherwise
+ */
+static hashtable_sketch_t *hashtable_sketch_create(size_t size);
+
+/**
+ * @brief Record an access to a key in the frequency sketch, counters are halved periodically
+ * @param sketch Frequency sketch of the shard, which may be accessed concurrently by readers
+ * @param hash Hash value of the key
+ */
+static void hashtable_sketch_record(hashtable_sketch_t *sketch, uint64_t hash);
+
+/**
+ * @brief Estimate the number of accesses to a key recorded in the frequency sketch
+ * @param sketch Frequency sketch of the shard
+ * @param hash Hash value of the key
+ * @return Minimum of the counters of the key in each row
+ */
+static uint8_t hashtable_sketch_estimate(hashtable_sketch_t *sketch, uint64_t hash);
+
+/**
+ * @brief Unlink the element from the shard and discard it, the element is given to the evict function or released
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the shard
+ * @return 0 if the function succeeded, -1 if memory can not be allocated while snapshots exist
+ */
+static int hashtable_discard(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element);
+
+/**
+ * @brief Get the current time of the monotonic clock
+ * @return Current time in milliseconds
+ */
+static uint64_t hashtable_clock(void);
+
+/**
+ * @brief Add the element to the slot of the timer wheel matching the time remaining before its expiration
+ * @param wheel Timer wheel of the shard
+ * @param element Element of the shard, which is not in the timer wheel
+ */
+static void hashtable_timer_add(hashtable_wheel_t *wheel, hashtable_element_t *element);
+
+/**
+ * @brief Remove the element from the timer wheel if it is in the timer wheel
+ * @param wheel Timer wheel of the shard
+ * @param element Element of the shard
+ */
+static void hashtable_timer_remove(hashtable_wheel_t *wheel, hashtable_element_t *element);
+
+/**
+ * @brief Remove the elements of the shard which have expired, the timer wheel is advanced up to the current time
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @return Number of elements removed
+ */
+static size_t hashtable_expire_shard(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Call the wanted function for each element of the shard, the function may release the element
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param fct Function called for each element
+ * @param user User data given to the function
+ */
+static void hashtable_foreach(hashtable_t *hashtable, hashtable_shard_t *shard, void (*fct)(hashtable_element_t *, void *), void *user);
+
+/**
+ * @brief Store the key of the element at the position pointed by the cursor, used by hashtable_get_keys
+ * @param element Element of the hashtable
+ * @param user Cursor in the table of keys
+ */
+static void hashtable_get_keys_cb(hashtable_element_t *element, void *user);
+
+/**
+ * @brief Store the element in the snapshot if it has not been modified since the cut, used by hashtable_snapshot_shard
+ * @param element Element of the hashtable
+ * @param user Snapshot cursor
+ */
+static void hashtable_snapshot_cb(hashtable_element_t *element, void *user);
+
+/**
+ * @brief Count the element or store it at the position pointed by the cursor, the key and the counter are copied
+ * @param cursor Snapshot cursor
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element itself, or its counter
+ * @param counter Flag set if the element is a counter
+ */
+static void hashtable_snapshot_store(hashtable_snapshot_cursor_t *cursor, const char *key, size_t key_len, void *e, bool counter);
+
+/**
+ * @brief Store the elements of the shard in the snapshot as they were at the cut, the shard is not pending for the snapshot anymore
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param snapshot Snapshot of the hashtable
+ * @param index Index of the shard
+ * @return 0 if the function succeeded, -1 if memory can not be allocated
+ */
+static int hashtable_snapshot_shard(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_snapshot_t *snapshot, size_t index);
+
+/**
+ * @brief Mark the shard as not pending for the snapshot anymore, history records are released once no snapshot of the shard is pending
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param cut Cut of the snapshot
+ */
+static void hashtable_snapshot_done(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_cut_t *cut);
+
+/**
+ * @brief Check if a snapshot of the shard includes a state of an element, or may include it because its cut is not known yet
+ * @param shard Shard of the hashtable locked for writing
+ * @param version Version of the element
+ * @param replaced Version of the shard once the element has been modified or removed, UINT64_MAX if it is still in the shard
+ * @return true if a snapshot may include the state of the element, false otherwise
+ */
+static bool hashtable_snapshot_covers(hashtable_shard_t *shard, uint64_t version, uint64_t replaced);
+
+/**
+ * @brief Record the state of an element before it is modified or removed while snapshots of the shard are pending
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing, history record allocated in advance by hashtable_retire_reserve
+ * @param element Element of the shard
+ */
+static void hashtable_history_record(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element);
+
+/**
+ * @brief Release the element, used by hashtable_release
+ * @param element Element of the hashtable
+ * @param user Hashtable instance
+ */
+static void hashtable_release_cb(hashtable_element_t *element, void *user);
+
+/**
+ * @brief Reverse the bits of the value
+ * @param v Value
+ * @return Value with reversed bits
+ */
+static uint64_t hashtable_scan_reverse(uint64_t v);
+
+/**
+ * @brief Increment the reversed bits of the cursor covered by the mask, used by hashtable_scan
+ * @param v Cursor
+ * @param mask Mask of the buckets of the table, size of the table minus one
+ * @return Next cursor, 0 if all buckets covered by the mask have been visited
+ */
+static uint64_t hashtable_scan_next(uint64_t v, uint64_t mask);
+
+/**
+ * @brief Visit the buckets of the shard pointed by the cursor, used by hashtable_scan
+ * When a rehash is in progress, the bucket of the smallest table and all the buckets of the largest table it expands to are visited.
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param v Cursor in the shard
+ * @param fct Function called for each element of the visited buckets
+ * @param user User data given to the function
+ * @return Next cursor in the shard, 0 if all buckets of the shard have been visited
+ */
+static uint64_t hashtable_scan_shard(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t v, hashtable_scan_fct_t fct, void *user);
+
+/**
+ * @brief Mix hash value so that all its bits depend on all the bits of the input value
+ * @param hash Hash value
+ * @return Mixed hash value
+ */
+static uint64_t hashtable_mix(uint64_t hash);
+
+/**
+ * @brief Lookup for the element with the wanted key in the shard locked for reading
+ * In HASHTABLE_LOCK_RCU mode, the lookup is done again if elements have been migrated in the meantime. Even without lock, the lookup writes to shared
+ * memory when the shard is bounded: the access is recorded in the frequency sketch and the referenced flag of the element is set if it was cleared.
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element of the shard, NULL if not found
+ */
+static hashtable_element_t *hashtable_find_read(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash);
+
+/**
+ * @brief Prefetch the memory which will be accessed by the lookup of the wanted hash value in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for reading
+ * @param hash Hash value of the key
+ * @param element false to prefetch the list of elements, true to prefetch the first candidate element
+ */
+static void hashtable_prefetch(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t hash, bool element);
+
+/**
+ * @brief Lookup for several elements, keys are grouped by shard and memory accesses of the lookups are interleaved
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param values Elements of the hashtable, NULL if not found, may be NULL
+ * @param bitmap Bitmap of the keys found in the hashtable, may be NULL
+ * @return Number of keys found in the hashtable
+ */
+static size_t hashtable_lookup_many(hashtable_t *hashtable, char **keys, size_t n, void **values, uint8_t *bitmap);
+
+/**
+ * @brief Create a table of lists of elements
+ * @param size Number of lists of elements
+ * @return Table of lists of elements if the function succeeded, NULL otherwise
+ */
+static hashtable_table_t *hashtable_table_create(size_t size);
+
+/**
+ * @brief Start resizing the shard, elements are then migrated by the next operations
+ * @param shard Shard of the hashtable
+ * @param size New horizontal size of the shard
+ */
+static void hashtable_resize(hashtable_shard_t *shard, size_t size);
+
+/**
+ * @brief Check load factor of the shard and start resizing it if required
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ */
+static void hashtable_check_load(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Migrate some lists of elements from table[0] to table[1] when a rehash of the shard is in progress
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param step Number of lists of elements to be migrated
+ */
+static void hashtable_rehash(hashtable_t *hashtable, hashtable_shard_t *shard, size_t step);
+
+/**
+ * @brief Release memory block which may still be accessed by readers, release is deferred in HASHTABLE_LOCK_RCU mode or while snapshots reference it
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param ptr Memory block to be released
+ * @param type Type of the memory block
+ * @param version Version of the element when the value has been stored, only used if the memory block is a value
+ */
+static void hashtable_retire(hashtable_t *hashtable, hashtable_shard_t *shard, void *ptr, hashtable_retired_type_t type, uint64_t version);
+
+/**
+ * @brief Add memory block to the list of retired memory blocks of the shard, which are released once readers are done
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param retired Retired memory block
+ */
+static void hashtable_retired_append(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_retired_t *retired);
+
+/**
+ * @brief Check if a retired memory block is still referenced by snapshots of the shard
+ * @param shard Shard of the hashtable locked for writing
+ * @param retired Retired memory block
+ * @return true if the memory block is referenced by snapshots, false otherwise
+ */
+static bool hashtable_retired_pinned(hashtable_shard_t *shard, hashtable_retired_t *retired);
+
+/**
+ * @brief Move the memory blocks which are not referenced by snapshots anymore to the list of retired memory blocks, called when a snapshot is done
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ */
+static void hashtable_unpin(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Allocate in advance the memory needed to retire elements and values while snapshots exist, and to record the element modified
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param count Number of elements and values which may be retired
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int hashtable_retire_reserve(hashtable_t *hashtable, hashtable_shard_t *shard, size_t count);
+
+/**
+ * @brief Release memory block which can not be accessed by readers anymore
+ * @param hashtable Hashtable instance
+ * @param ptr Memory block to be released
+ * @param type Type of the memory block
+ */
+static void hashtable_retired_free(hashtable_t *hashtable, void *ptr, hashtable_retired_type_t type);
+
+/**
+ * @brief Release retired memory blocks of the shard which can not be accessed by readers anymore
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ */
+static void hashtable_reclaim(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Create the key releasing the reader slot of the threads when they exit, called once
+ */
+static void hashtable_epoch_init(void);
+
+/**
+ * @brief Give a reader slot to the current thread, the least used slot with the lowest index is chosen so that free slots are used first
+ * @return Reader slot of the current thread
+ */
+static size_t hashtable_epoch_acquire(void);
+
+/**
+ * @brief Give the reader slot of a thread back when it exits
+ * @param value Reader slot of the thread plus one
+ */
+static void hashtable_epoch_release(void *value);
+
+/**
+ * @brief Enter the current epoch, memory blocks retired from now are not released until the reader exits
+ * @param hashtable Hashtable instance
+ * @return Epoch entered by the reader
+ */
+static unsigned long hashtable_epoch_enter(hashtable_t *hashtable);
+
+/**
+ * @brief Exit epoch previously entered by the reader
+ * @param hashtable Hashtable instance
+ * @param epoch Epoch entered by the reader
+ */
+static void hashtable_epoch_exit(hashtable_t *hashtable, unsigned long epoch);
+
+/**
+ * @brief Advance the current epoch if all readers of the previous epoch have exited
+ * @param hashtable Hashtable instance
+ */
+static void hashtable_epoch_advance(hashtable_t *hashtable);
+
+/**
+ * @brief Lock the shard for reading
+ * The access is shared with other readers in HASHTABLE_LOCK_RWLOCK mode, and no lock is taken in HASHTABLE_LOCK_RCU mode.
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @return Epoch entered by the reader in HASHTABLE_LOCK_RCU mode, 0 otherwise
+ */
+static unsigned long hashtable_lock_read(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Unlock the shard locked for reading
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param epoch Epoch returned by hashtable_lock_read
+ */
+static void hashtable_unlock_read(hashtable_t *hashtable, hashtable_shard_t *shard, unsigned long epoch);
+
+/**
+ * @brief Lock the shard for writing, the access is exclusive
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ */
+static void hashtable_lock_write(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/**
+ * @brief Unlock the shard locked for writing
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ */
+static void hashtable_unlock(hashtable_t *hashtable, hashtable_shard_t *shard);
+
+/******************************************************************************/
+/* Functions                                                                  */
+/******************************************************************************/
+
+/**
+ * @brief Function used to create hashtable instance
+ * @param size Horizontal size of the hashtable
+ * @param alloc true if element should be allocated when they are added in the hashtable, false for a copy only
+ * @return Hashtable instance if the function succeeded, NULL otherwise
+ */
+hashtable_t *
+hashtable_create(size_t size, bool alloc) {
+
+    hashtable_config_t config;
+
+    /* Create hashtable instance with default configuration */
+    hashtable_config_init(&config);
+    config.size  = size;
+    config.alloc = alloc;
+
+    return hashtable_create_with_config(&config);
+}
+
+/**
+ * @brief Initialize hashtable configuration with default values
+ * @param config Hashtable configuration
+ */
+void
+hashtable_config_init(hashtable_config_t *config) {
+
+    assert(NULL != config);
+
+    /* Set default values */
+    memset(config, 0, sizeof(hashtable_config_t));
+    config->size       = 64;
+    config->alloc      = false;
+    config->grow       = true;
+    config->shrink     = false;
+    config->lock       = HASHTABLE_LOCK_MUTEX;
+    config->shards     = 1;
+    config->hash       = HASHTABLE_HASH_WYHASH;
+    config->hash_fct   = NULL;
+    config->seed       = 0;
+    config->capacity   = 0;
+    config->memory     = 0;
+    config->admission  = false;
+    config->refcount   = false;
+    config->evict_fct  = NULL;
+    config->evict_user = NULL;
+}
+
+/**
+ * @brief Function used to create hashtable instance with a specific configuration
+ * @param config Hashtable configuration
+ * @return Hashtable instance if the function succeeded, NULL otherwise
+ */
+hashtable_t *
+hashtable_create_with_config(hashtable_config_t *config) {
+
+    assert(NULL != config);
+
+    /* Check configuration */
+    if ((0 == config->size) || (0 == config->shards)) {
+        /* Invalid size or number of shards */
+        return NULL;
+    }
+    if (((0 != config->capacity) && (config->capacity < config->shards)) || ((0 != config->memory) && (config->memory < config->shards))) {
+        /* Capacity or memory can not be shared between the shards */
+        return NULL;
+    }
+    if ((true == config->refcount) && (false == config->alloc)) {
+        /* Only values copied by the hashtable can be reference counted */
+        return NULL;
+    }
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable = (hashtable_t *)malloc(sizeof(hashtable_t));
+    if (NULL == hashtable) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+    memset(hashtable, 0, sizeof(hashtable_t));
+
+    /* Save configuration, the initial size is shared between the shards and rounded up to a power of two */
+    memcpy(&hashtable->config, config, sizeof(hashtable_config_t));
+    size_t shard_size     = (config->size > config->shards) ? config->size / config->shards : 1;
+    hashtable->shard_size = 1;
+    while (hashtable->shard_size < shard_size) {
+        hashtable->shard_size *= 2;
+    }
+
+    /* Initialize keys of the hash function, the identifier is never 0 so that pre-hashed keys which are not initialized are detected */
+    hashtable_init_seed(hashtable);
+    uint64_t fct       = (NULL != config->hash_fct) ? (uint64_t)(uintptr_t)config->hash_fct : (uint64_t)config->hash;
+    hashtable->hash_id = hashtable_mix(hashtable->seed[0] ^ hashtable_mix(hashtable->seed[1] ^ fct)) | 1;
+
+    /* Create reader slots, aligned on cache lines */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        if (0 != posix_memalign((void **)&hashtable->slots, HASHTABLE_EPOCH_SLOT_SIZE, HASHTABLE_EPOCH_SLOTS * sizeof(hashtable_epoch_slot_t))) {
+            /* Unable to allocate memory */
+            free(hashtable);
+            return NULL;
+        }
+        memset(hashtable->slots, 0, HASHTABLE_EPOCH_SLOTS * sizeof(hashtable_epoch_slot_t));
+    }
+
+    /* Create shards */
+    if (NULL == (hashtable->shards = (hashtable_shard_t *)malloc(config->shards * sizeof(hashtable_shard_t)))) {
+        /* Unable to allocate memory */
+        free(hashtable->slots);
+        free(hashtable);
+        return NULL;
+    }
+    memset(hashtable->shards, 0, config->shards * sizeof(hashtable_shard_t));
+    for (size_t index = 0; index < config->shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+
+        /* Share the capacity and the memory between the shards, each shard evicting its own elements, the first shards get the remainder */
+        shard->capacity = config->capacity / config->shards + ((index < config->capacity % config->shards) ? 1 : 0);
+        shard->memory   = config->memory / config->shards + ((index < config->memory % config->shards) ? 1 : 0);
+
+        /* Create table of lists of elements */
+        if (NULL == (shard->table[0] = hashtable_table_create(hashtable->shard_size))) {
+            /* Unable to allocate memory */
+            hashtable->config.shards = index;
+            hashtable_release(hashtable);
+            return NULL;
+        }
+
+        /* Create frequency sketch of the shard, sized for the number of elements it can store */
+        if ((true == config->admission) && ((0 != shard->capacity) || (0 != shard->memory))) {
+            size_t count = shard->memory / sizeof(hashtable_element_t);
+            if ((0 != shard->capacity) && ((0 == count) || (shard->capacity < count))) {
+                count = shard->capacity;
+            }
+            size_t size = 64;
+            while (size < count) {
+                size *= 2;
+            }
+            if (NULL == (shard->sketch = hashtable_sketch_create(size))) {
+                /* Unable to allocate memory */
+                free(shard->table[0]);
+                hashtable->config.shards = index;
+                hashtable_release(hashtable);
+                return NULL;
+            }
+        }
+
+        /* Initialize semaphore or read-write lock used to access the shard */
+        if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+            if (0 != pthread_rwlock_init(&shard->rwlock, NULL)) {
+                /* Unable to initialize read-write lock */
+                free(shard->table[0]);
+                free(shard->sketch);
+                hashtable->config.shards = index;
+                hashtable_release(hashtable);
+                return NULL;
+            }
+        } else {
+            sem_init(&shard->sem, 0, 1);
+        }
+        pthread_mutex_init(&shard->loads_mutex, NULL);
+    }
+
+    return hashtable;
+}
+
+/**
+ * @brief Initialize pre-hashed key, which can be used with all hashtables sharing the same hash function and seed
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key
+ * @param key Key of the element, binary data which is not required to be NUL-terminated, must remain valid while the pre-hashed key is used
+ * @param key_len Length of the key in bytes
+ */
+void
+hashtable_key_init(hashtable_t *hashtable, hashtable_key_t *hk, const void *key, size_t key_len) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != key);
+
+    /* Compute hash value of the key and remember the hash function used */
+    hk->key     = key;
+    hk->key_len = key_len;
+    hk->hash    = hashtable_compute_hash(hashtable, key, key_len);
+    hk->hash_id = hashtable->hash_id;
+}
+
+/**
+ * @brief Add element to the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add(hashtable_t *hashtable, char *key, void *e, size_t size) {
+
+    assert(NULL != key);
+
+    return hashtable_add_n(hashtable, key, strlen(key), e, size);
+}
+
+/**
+ * @brief Add element to the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_add_hk(hashtable, &hk, e, size);
+}
+
+/**
+ * @brief Add element to the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element to be added, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size) {
+
+    return hashtable_add_ttl_hk(hashtable, hk, e, size, 0);
+}
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add_ttl(hashtable_t *hashtable, char *key, void *e, size_t size, uint64_t ttl) {
+
+    assert(NULL != key);
+
+    return hashtable_add_ttl_n(hashtable, key, strlen(key), e, size, ttl);
+}
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param key Key of the element to be added, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add_ttl_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, uint64_t ttl) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_add_ttl_hk(hashtable, &hk, e, size, ttl);
+}
+
+/**
+ * @brief Add element to the hashtable, the element expires after the wanted time to live
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element to be added, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param ttl Time to live of the element in milliseconds, 0 if the element does not expire
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_add_ttl_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, uint64_t ttl) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Create the timer wheel of the shard with its first element which expires */
+    if ((0 != ttl) && (NULL == shard->wheel)) {
+        hashtable_wheel_t *wheel = (hashtable_wheel_t *)malloc(sizeof(hashtable_wheel_t));
+        if (NULL == wheel) {
+            /* Unable to allocate memory */
+            hashtable_unlock(hashtable, shard);
+            return -1;
+        }
+        memset(wheel, 0, sizeof(hashtable_wheel_t));
+        wheel->now = hashtable_clock();
+        __atomic_store_n(&shard->wheel, wheel, __ATOMIC_RELAXED);
+    }
+
+    /* Check if the element already exist, update the element in this case, otherwise create a new hashtable element */
+    int                  ret  = 0;
+    hashtable_element_t *curr = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash);
+    if (NULL != curr) {
+        ret = hashtable_update(hashtable, shard, curr, e, size, NULL);
+    } else if (0 != (ret = hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + size))) {
+        if (1 == ret) {
+            hashtable_reject(hashtable, hk->key, hk->key_len, e);
+        }
+    } else if (NULL == (curr = hashtable_add_element(hashtable, shard, hk, hash, e, size, NULL))) {
+        ret = -1;
+    }
+
+    /* Add the element to the timer wheel, the expiration time saturates so that very long time to live never wrap to the past */
+    if ((0 == ret) && (NULL != curr) && (0 != ttl)) {
+        uint64_t now = hashtable_clock();
+        __atomic_store_n(&curr->expire, (ttl > UINT64_MAX - now) ? UINT64_MAX : now + ttl, __ATOMIC_RELAXED);
+        hashtable_timer_add(shard->wheel, curr);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return ret;
+}
+
+/**
+ * @brief Add several elements to the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements to be added
+ * @param values Elements to be added in the hashtable
+ * @param sizes Sizes of the elements to be added, NULL if all sizes are 0
+ * @param n Number of elements to be added
+ * @param unique true if the keys are known to be unique and not present in the hashtable, the existing elements are not looked up
+ * @return 0 if the function succeeded, 1 if some elements are not admitted, -1 otherwise, elements added before the failure remain in the hashtable
+ */
+int
+hashtable_add_bulk(hashtable_t *hashtable, char **keys, void **values, size_t *sizes, size_t n, bool unique) {
+
+    assert(NULL != hashtable);
+    assert((NULL != keys) || (0 == n));
+    assert((NULL != values) || (0 == n));
+
+    int                ret      = 0;
+    bool               rejected = false;
+    size_t             shards   = hashtable->config.shards;
+    hashtable_block_t *block    = NULL;
+    char *             cursor   = NULL;
+    size_t             avail    = 0;
+
+    /* Elements of bounded hashtables are allocated alone, a single element still stored would keep a whole block allocated after its neighbours
+     * have been evicted, while the memory of the shard only accounts for the element */
+    bool blocks = (0 == hashtable->config.capacity) && (0 == hashtable->config.memory);
+
+    /* Allocate hash values, lengths and order of the keys, and bounds of the keys of each shard */
+    uint64_t *hashes = (uint64_t *)malloc(n * (sizeof(uint64_t) + 2 * sizeof(size_t)) + (shards + 1) * sizeof(size_t));
+    if (NULL == hashes) {
+        /* Unable to allocate memory */
+        return -1;
+    }
+    size_t *lens  = (size_t *)(hashes + n);
+    size_t *order = lens + n;
+    size_t *start = order + n;
+    memset(start, 0, (shards + 1) * sizeof(size_t));
+
+    /* Compute hash values of all the keys and count the keys of each shard */
+    for (size_t index = 0; index < n; index++) {
+        assert(NULL != keys[index]);
+        lens[index]   = strlen(keys[index]);
+        hashes[index] = hashtable_compute_hash(hashtable, keys[index], lens[index]);
+        start[hashtable_get_shard(hashtable, hashes[index]) - hashtable->shards + 1]++;
+    }
+
+    /* Sort keys by shard, start[s] is then the end of the keys of shard s */
+    for (size_t s = 0; s < shards; s++) {
+        start[s + 1] += start[s];
+    }
+    for (size_t index = 0; index < n; index++) {
+        order[start[hashtable_get_shard(hashtable, hashes[index]) - hashtable->shards]++] = index;
+    }
+
+    /* Add the keys of each shard, which is locked once and sized for the final number of elements */
+    size_t begin = 0;
+    for (size_t s = 0; (s < shards) && (0 == ret); begin = start[s], s++) {
+        hashtable_shard_t *shard = &hashtable->shards[s];
+        if (begin == start[s]) {
+            continue;
+        }
+
+        /* Lock shard for writing, and remove the elements which have expired */
+        hashtable_lock_write(hashtable, shard);
+        hashtable_expire_shard(hashtable, shard);
+
+        /* Resize the shard at once */
+        hashtable_reserve(hashtable, shard, shard->count + start[s] - begin);
+
+        for (size_t k = begin; k < start[s]; k++) {
+            size_t index = order[k];
+            size_t size  = (NULL != sizes) ? sizes[index] : 0;
+
+            /* Check if the element already exist, update the element in this case */
+            if (false == unique) {
+                hashtable_element_t *curr = hashtable_search(hashtable, shard, keys[index], lens[index], hashes[index]);
+                if (NULL != curr) {
+                    if (0 != hashtable_update(hashtable, shard, curr, values[index], size, NULL)) {
+                        ret = -1;
+                        break;
+                    }
+                    continue;
+                }
+            }
+
+            /* Elements larger than the memory of the shard can not be added */
+            size_t element_size = hashtable_element_size(lens[index]);
+            if ((0 != shard->memory) && (element_size + size > shard->memory)) {
+                ret = -1;
+                break;
+            }
+
+            /* Elements which are not admitted are discarded */
+            int admit = hashtable_admit(hashtable, shard, hashes[index], element_size + size);
+            if (1 == admit) {
+                hashtable_reject(hashtable, keys[index], lens[index], values[index]);
+                rejected = true;
+                continue;
+            } else if (0 != admit) {
+                ret = -1;
+                break;
+            }
+
+            /* Allocate a new block for the next keys of the shard if the element does not fit in the current block, keys which update an element are skipped */
+            if ((true == blocks) && (element_size > avail)) {
+                avail = element_size;
+                for (size_t next = k + 1; (next < start[s]) && (next < k + HASHTABLE_BULK_BLOCK_SIZE); next++) {
+                    if ((true == unique) || (NULL == hashtable_search(hashtable, shard, keys[order[next]], lens[order[next]], hashes[order[next]]))) {
+                        avail += hashtable_element_size(lens[order[next]]);
+                    }
+                }
+                hashtable_block_release(block);
+                if (NULL == (block = (hashtable_block_t *)malloc(sizeof(hashtable_block_t) + avail))) {
+                    /* Unable to allocate memory */
+                    ret = -1;
+                    break;
+                }
+                /* The block is referenced by the function until all its elements have been added */
+                block->live = 1;
+                cursor      = (char *)(block + 1);
+            }
+
+            /* Create element in the block, or alone, and add it to the shard */
+            void *ptr = (true == blocks) ? cursor : malloc(element_size);
+            if (NULL == ptr) {
+                /* Unable to allocate memory */
+                ret = -1;
+                break;
+            }
+            hashtable_element_t *element
+                = hashtable_element_init(hashtable, ptr, (true == blocks) ? block : NULL, keys[index], lens[index], hashes[index], values[index], size);
+            if (NULL == element) {
+                /* Unable to allocate memory */
+                if (false == blocks) {
+                    free(ptr);
+                }
+                ret = -1;
+                break;
+            }
+            hashtable_element_version(shard, element);
+            if ((0 != hashtable_make_room(hashtable, shard, element_size + size, NULL)) || (0 != hashtable_insert(hashtable, shard, element, hashes[index]))) {
+                /* Unable to insert the element */
+                if ((true == hashtable->config.alloc) && (NULL != element->e)) {
+                    hashtable_value_put(hashtable, element->e);
+                }
+                if (false == blocks) {
+                    free(ptr);
+                }
+                ret = -1;
+                break;
+            }
+            __atomic_store_n(&shard->count, shard->count + 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&shard->bytes, shard->bytes + element_size + size, __ATOMIC_RELAXED);
+            if (true == blocks) {
+                __atomic_fetch_add(&block->live, 1, __ATOMIC_RELAXED);
+                cursor += element_size;
+                avail -= element_size;
+            }
+        }
+
+        /* Check if the shard should be resized */
+        hashtable_check_load(hashtable, shard);
+
+        /* Unlock shard */
+        hashtable_unlock(hashtable, shard);
+    }
+
+    /* Release memory */
+    hashtable_block_release(block);
+    free(hashes);
+
+    return ((0 == ret) && (true == rejected)) ? 1 : ret;
+}
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+void *
+hashtable_lookup_or_add(hashtable_t *hashtable, char *key, void *e, size_t size) {
+
+    assert(NULL != key);
+
+    return hashtable_lookup_or_add_n(hashtable, key, strlen(key), e, size);
+}
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+void *
+hashtable_lookup_or_add_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_lookup_or_add_hk(hashtable, &hk, e, size);
+}
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element of the hashtable, which is the added one if the key was not found, NULL if it can not be added
+ */
+void *
+hashtable_lookup_or_add_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    return hashtable_lookup_or_add_element(hashtable, hk, e, size, false, NULL, NULL, hashtable->config.refcount);
+}
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+void *
+hashtable_lookup_or_create(hashtable_t *hashtable, char *key, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    return hashtable_lookup_or_create_n(hashtable, key, strlen(key), fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+void *
+hashtable_lookup_or_create_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_lookup_or_create_hk(hashtable, &hk, fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable, create and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function creating the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, which is the created one if the key was not found, NULL if it can not be created or added
+ */
+void *
+hashtable_lookup_or_create_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != fct);
+
+    return hashtable_lookup_or_add_element(hashtable, hk, NULL, 0, true, fct, user, hashtable->config.refcount);
+}
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_replace(hashtable_t *hashtable, char *key, void *e, size_t size, void **prev) {
+
+    assert(NULL != key);
+
+    return hashtable_replace_n(hashtable, key, strlen(key), e, size, prev);
+}
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_replace_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, void **prev) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_replace_hk(hashtable, &hk, e, size, prev);
+}
+
+/**
+ * @brief Add element to the hashtable and get the element it replaces
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param prev Previous element of the hashtable, NULL if the key was not found, the previous element is not released
+ * @return 0 if the function succeeded, 1 if the element is not admitted, -1 otherwise
+ */
+int
+hashtable_replace_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, void **prev) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != prev);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Replace the element if it already exist, create a new hashtable element otherwise */
+    int                  ret  = 0;
+    hashtable_element_t *curr = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash);
+    *prev                     = NULL;
+    if (NULL != curr) {
+        ret = hashtable_update(hashtable, shard, curr, e, size, prev);
+    } else if (0 != (ret = hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + size))) {
+        if (1 == ret) {
+            hashtable_reject(hashtable, hk->key, hk->key_len, e);
+        }
+    } else if (NULL == hashtable_add_element(hashtable, shard, hk, hash, e, size, NULL)) {
+        ret = -1;
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return ret;
+}
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+int
+hashtable_compute(hashtable_t *hashtable, char *key, hashtable_compute_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    return hashtable_compute_n(hashtable, key, strlen(key), fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+int
+hashtable_compute_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_compute_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_compute_hk(hashtable, &hk, fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable and add, replace or remove it according to a function while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function called with the element, or without it if the key is not found, while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 otherwise
+ */
+int
+hashtable_compute_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_compute_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != fct);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Lookup for the wanted element, values included in snapshots are not modified in place: the function is given a private copy which replaces the
+     * value if it is modified, counters are recorded first if snapshots of the shard are pending */
+    int                  ret     = 0;
+    hashtable_element_t *curr    = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash);
+    void *               e       = (NULL != curr) ? curr->e : NULL;
+    size_t               size    = (NULL != curr) ? curr->size : 0;
+    void *               copy    = NULL;
+    bool                 shared  = (NULL != curr) && (true == hashtable_value_shared(hashtable, shard, curr));
+    bool                 counter = (NULL != curr) && (NULL != hashtable_element_counter(curr));
+    if (((true == shared) && (NULL == (copy = malloc(size)))) || ((true == counter) && (0 != hashtable_retire_reserve(hashtable, shard, 0)))) {
+        /* Unable to allocate memory */
+        hashtable_unlock(hashtable, shard);
+        return -1;
+    }
+    if (true == shared) {
+        e = memcpy(copy, curr->e, size);
+    } else if (true == counter) {
+        hashtable_history_record(hashtable, shard, curr);
+    }
+
+    /* Compute the new element, a private copy modified by the function is stored */
+    hashtable_compute_t action = fct((const char *)hk->key, hk->key_len, (NULL != curr), &e, &size, user);
+    if ((HASHTABLE_COMPUTE_KEEP == action) && (NULL != copy) && (0 != memcmp(copy, curr->e, curr->size))) {
+        action = HASHTABLE_COMPUTE_SET;
+        e      = copy;
+        size   = curr->size;
+    } else if ((HASHTABLE_COMPUTE_KEEP == action) && (true == counter) && (0 < shard->pending)) {
+        hashtable_element_version(shard, curr);
+    }
+
+    /* Replace or add the element, the previous one is released in alloc mode */
+    if ((HASHTABLE_COMPUTE_SET == action) && (NULL != curr)) {
+        ret = hashtable_update(hashtable, shard, curr, e, size, NULL);
+    } else if ((HASHTABLE_COMPUTE_SET == action) && (0 != (ret = hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + size)))) {
+        if (1 == ret) {
+            hashtable_reject(hashtable, hk->key, hk->key_len, e);
+        }
+    } else if (HASHTABLE_COMPUTE_SET == action) {
+        ret = (NULL != hashtable_add_element(hashtable, shard, hk, hash, e, size, NULL)) ? 0 : -1;
+    }
+
+    /* Remove the element, its value is released in alloc mode */
+    if ((HASHTABLE_COMPUTE_REMOVE == action) && (NULL != curr) && (0 != hashtable_retire_reserve(hashtable, shard, 2))) {
+        /* Unable to allocate memory */
+        ret = -1;
+    } else if ((HASHTABLE_COMPUTE_REMOVE == action) && (NULL != curr)) {
+        curr = hashtable_unlink(hashtable, shard, hk->key, hk->key_len, hash);
+        e    = hashtable_element_value(curr);
+        __atomic_store_n(&shard->count, shard->count - 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&shard->bytes, shard->bytes - hashtable_element_bytes(curr), __ATOMIC_RELAXED);
+        /* Release memory */
+        if ((true == hashtable->config.alloc) && (NULL != e)) {
+            hashtable_retire(hashtable, shard, e, HASHTABLE_RETIRED_VALUE, __atomic_load_n(&curr->version, __ATOMIC_RELAXED));
+        }
+        hashtable_retire(hashtable, shard, curr, HASHTABLE_RETIRED_ELEMENT, 0);
+        /* Check if the shard should be resized */
+        hashtable_check_load(hashtable, shard);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    /* Release the private copy, the element stored is copied */
+    free(copy);
+
+    return ret;
+}
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+int
+hashtable_add_if_version(hashtable_t *hashtable, char *key, void *e, size_t size, uint64_t version) {
+
+    assert(NULL != key);
+
+    return hashtable_add_if_version_n(hashtable, key, strlen(key), e, size, version);
+}
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+int
+hashtable_add_if_version_n(hashtable_t *hashtable, const void *key, size_t key_len, void *e, size_t size, uint64_t version) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_add_if_version_hk(hashtable, &hk, e, size, version);
+}
+
+/**
+ * @brief Add element to the hashtable only if the version of the existing element matches
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @param version Expected version of the element, 0 if the key is expected not to be found
+ * @return 0 if the function succeeded, 1 if the element to be added is not admitted, -1 if the version does not match or if memory can not be allocated
+ */
+int
+hashtable_add_if_version_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, uint64_t version) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Update the element if its version matches, create a new hashtable element if it is not found and not expected to be */
+    int                  ret  = -1;
+    hashtable_element_t *curr = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash);
+    if ((NULL != curr) && (version == __atomic_load_n(&curr->version, __ATOMIC_RELAXED))) {
+        ret = hashtable_update(hashtable, shard, curr, e, size, NULL);
+    } else if ((NULL == curr) && (0 == version) && (0 != (ret = hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + size)))) {
+        if (1 == ret) {
+            hashtable_reject(hashtable, hk->key, hk->key_len, e);
+        }
+    } else if ((NULL == curr) && (0 == version)) {
+        ret = (NULL != hashtable_add_element(hashtable, shard, hk, hash, e, size, NULL)) ? 0 : -1;
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return ret;
+}
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the counter
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+int
+hashtable_incr(hashtable_t *hashtable, char *key, int64_t delta, int64_t *value) {
+
+    assert(NULL != key);
+
+    return hashtable_incr_n(hashtable, key, strlen(key), delta, value);
+}
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the counter, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+int
+hashtable_incr_n(hashtable_t *hashtable, const void *key, size_t key_len, int64_t delta, int64_t *value) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_incr_hk(hashtable, &hk, delta, value);
+}
+
+/**
+ * @brief Add delta to the counter of the hashtable, the counter is created if it is not found
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the counter, initialized with hashtable_key_init
+ * @param delta Value added to the counter
+ * @param value New value of the counter, may be NULL
+ * @return 0 if the function succeeded, 1 if the counter to be created is not admitted, -1 if the key is not a counter or if memory can not be allocated
+ */
+int
+hashtable_incr_hk(hashtable_t *hashtable, hashtable_key_t *hk, int64_t delta, int64_t *value) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    int     ret    = 0;
+    int64_t result = 0;
+
+    /* Counters are stored in the elements and can not be reference counted */
+    if (true == hashtable->config.refcount) {
+        return -1;
+    }
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for reading, existing counters are updated atomically so that readers can share the shard, the generation is read before the lookup
+     * so that a counter removed in the meantime is detected in HASHTABLE_LOCK_RCU mode */
+    unsigned long epoch      = hashtable_lock_read(hashtable, shard);
+    unsigned long generation = __atomic_load_n(&shard->generation, __ATOMIC_ACQUIRE);
+
+    /* Lookup for the wanted counter and update it, unless snapshots of the shard are pending and the modification must be recorded */
+    bool                 done = false;
+    hashtable_element_t *curr = NULL;
+    if (0 == __atomic_load_n(&shard->pending, __ATOMIC_SEQ_CST)) {
+        curr = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    }
+    if (NULL != curr) {
+        int64_t *counter = hashtable_element_counter(curr);
+        if (NULL != counter) {
+            result = __atomic_add_fetch(counter, delta, __ATOMIC_SEQ_CST);
+            hashtable_element_version(shard, curr);
+            /* Without lock, the counter may have been removed or replaced before the addition, which is then lost: the counter is checked to be still in
+             * the shard with the shard locked for writing, the element can not be released while the epoch is not exited */
+            done = (HASHTABLE_LOCK_RCU != hashtable->config.lock)
+                   || ((generation == __atomic_load_n(&shard->generation, __ATOMIC_SEQ_CST)) && (counter == hashtable_element_counter(curr)));
+            if (false == done) {
+                hashtable_lock_write(hashtable, shard);
+                done = (curr == hashtable_search(hashtable, shard, hk->key, hk->key_len, hash)) && (counter == hashtable_element_counter(curr));
+                hashtable_unlock(hashtable, shard);
+            }
+        } else {
+            ret  = -1;
+            done = true;
+        }
+    }
+
+    /* Unlock shard */
+    hashtable_unlock_read(hashtable, shard, epoch);
+
+    /* Counter not found or removed while it was updated, lock shard for writing and update or create it unless it has been created in the meantime */
+    if (false == done) {
+        hashtable_lock_write(hashtable, shard);
+        hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+        hashtable_expire_shard(hashtable, shard);
+        if (NULL != (curr = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash))) {
+            int64_t *counter = hashtable_element_counter(curr);
+            if ((NULL != counter) && (0 == hashtable_retire_reserve(hashtable, shard, 0))) {
+                hashtable_history_record(hashtable, shard, curr);
+                result = __atomic_add_fetch(counter, delta, __ATOMIC_RELAXED);
+                hashtable_element_version(shard, curr);
+            } else {
+                ret = -1;
+            }
+        } else if (0 == (ret = hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + sizeof(int64_t)))) {
+            /* The counter is only created if it is admitted, a rejected counter has no value to be given to the evict function */
+            if (NULL != hashtable_add_element(hashtable, shard, hk, hash, NULL, 0, &delta)) {
+                result = delta;
+            } else {
+                ret = -1;
+            }
+        }
+        hashtable_unlock(hashtable, shard);
+    }
+
+    /* Return the new value of the counter */
+    if ((0 == ret) && (NULL != value)) {
+        *value = result;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+void *
+hashtable_get_or_load(hashtable_t *hashtable, char *key, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    return hashtable_get_or_load_n(hashtable, key, strlen(key), fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+void *
+hashtable_get_or_load_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_get_or_load_hk(hashtable, &hk, fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable, load and add it if it is not found
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function loading the element to be added, only called if the key is not found
+ * @param user User data given to the function
+ * @return Element of the hashtable, NULL if it can not be loaded or added
+ */
+void *
+hashtable_get_or_load_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_create_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != fct);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lookup for the wanted element */
+    unsigned long        epoch = hashtable_lock_read(hashtable, shard);
+    hashtable_element_t *curr  = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    void *               e     = (NULL != curr) ? hashtable_value_get(hashtable, curr) : NULL;
+    hashtable_unlock_read(hashtable, shard, epoch);
+    if (NULL != curr) {
+        return e;
+    }
+
+    /* Element not found, wait for the load in progress of the same key if any */
+    pthread_mutex_lock(&shard->loads_mutex);
+    hashtable_load_t *load = shard->loads;
+    while ((NULL != load) && ((load->hash != hash) || (load->key_len != hk->key_len) || (0 != memcmp(load->key, hk->key, hk->key_len)))) {
+        load = load->next;
+    }
+    if (NULL != load) {
+        load->waiters++;
+        while (false == load->done) {
+            pthread_cond_wait(&load->cond, &shard->loads_mutex);
+        }
+        e = load->e;
+        /* The last waiter releases the load */
+        if (0 == --load->waiters) {
+            pthread_cond_destroy(&load->cond);
+            free(load);
+        }
+        pthread_mutex_unlock(&shard->loads_mutex);
+        return e;
+    }
+
+    /* No load in progress, register a new one so that the next threads missing the key wait for it */
+    if (NULL == (load = (hashtable_load_t *)malloc(sizeof(hashtable_load_t)))) {
+        /* Unable to allocate memory */
+        pthread_mutex_unlock(&shard->loads_mutex);
+        return NULL;
+    }
+    load->key     = hk->key;
+    load->key_len = hk->key_len;
+    load->hash    = hash;
+    load->done    = false;
+    load->e       = NULL;
+    load->waiters = 0;
+    pthread_cond_init(&load->cond, NULL);
+    load->next   = shard->loads;
+    shard->loads = load;
+    pthread_mutex_unlock(&shard->loads_mutex);
+
+    /* Load the element without locking the shard, unless it has been added since the lookup, and add it */
+    hashtable_key_t key = *hk;
+    key.hash            = hash;
+    key.hash_id         = hashtable->hash_id;
+    epoch               = hashtable_lock_read(hashtable, shard);
+    curr                = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    e                   = (NULL != curr) ? hashtable_value_get(hashtable, curr) : NULL;
+    hashtable_unlock_read(hashtable, shard, epoch);
+    if (NULL == curr) {
+        size_t size = 0;
+        if (NULL != (e = fct(hk->key, hk->key_len, &size, user))) {
+            /* Loaded elements are submitted to the admission if values are reference counted, so that scans of keys loaded once do not evict the
+             * frequently accessed ones */
+            e = hashtable_lookup_or_add_element(hashtable, &key, e, size, true, NULL, NULL, hashtable->config.refcount);
+        }
+    }
+
+    /* Wake up the waiters, the load is released by the last of them */
+    pthread_mutex_lock(&shard->loads_mutex);
+    hashtable_load_t **prev = &shard->loads;
+    while (*prev != load) {
+        prev = &(*prev)->next;
+    }
+    *prev      = load->next;
+    load->e    = e;
+    load->done = true;
+    if ((true == hashtable->config.refcount) && (NULL != e)) {
+        /* Each waiter returns its own reference to the value, the loader still holds one */
+        __atomic_add_fetch(&((hashtable_value_t *)e - 1)->refs, load->waiters, __ATOMIC_RELAXED);
+    }
+    if (0 < load->waiters) {
+        pthread_cond_broadcast(&load->cond);
+    } else {
+        pthread_cond_destroy(&load->cond);
+        free(load);
+    }
+    pthread_mutex_unlock(&shard->loads_mutex);
+
+    return e;
+}
+
+/**
+ * @brief Remove the elements of the hashtable which have expired, elements are also removed when a shard is modified
+ * @param hashtable Hashtable instance
+ * @return Number of elements removed
+ */
+size_t
+hashtable_expire(hashtable_t *hashtable) {
+
+    assert(NULL != hashtable);
+
+    size_t count = 0;
+
+    /* Parse shards which have elements expiring */
+    for (size_t index = 0; index < hashtable->config.shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+        if (NULL != __atomic_load_n(&shard->wheel, __ATOMIC_RELAXED)) {
+            hashtable_lock_write(hashtable, shard);
+            count += hashtable_expire_shard(hashtable, shard);
+            hashtable_unlock(hashtable, shard);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Get number of element in the hashtable
+ * @param hashtable Hashtable instance
+ * @return Number of elements in the hashtable
+ */
+size_t
+hashtable_get_count(hashtable_t *hashtable) {
+
+    assert(NULL != hashtable);
+
+    size_t count = 0;
+
+    /* Get number of elements of each shard */
+    for (size_t index = 0; index < hashtable->config.shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+        unsigned long      epoch = hashtable_lock_read(hashtable, shard);
+        count += __atomic_load_n(&shard->count, __ATOMIC_RELAXED);
+        hashtable_unlock_read(hashtable, shard, epoch);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Get number of bytes used by the elements of the hashtable
+ * @param hashtable Hashtable instance
+ * @return Number of bytes used by the elements, with their keys and their values
+ */
+size_t
+hashtable_get_memory(hashtable_t *hashtable) {
+
+    assert(NULL != hashtable);
+
+    size_t bytes = 0;
+
+    /* Get number of bytes of each shard */
+    for (size_t index = 0; index < hashtable->config.shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+        unsigned long      epoch = hashtable_lock_read(hashtable, shard);
+        bytes += __atomic_load_n(&shard->bytes, __ATOMIC_RELAXED);
+        hashtable_unlock_read(hashtable, shard, epoch);
+    }
+
+    return bytes;
+}
+
+/**
+ * @brief Check if key is present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_has_key(hashtable_t *hashtable, char *key) {
+
+    assert(NULL != key);
+
+    return hashtable_has_key_n(hashtable, key, strlen(key));
+}
+
+/**
+ * @brief Check if key is present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_has_key_n(hashtable_t *hashtable, const void *key, size_t key_len) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_has_key_hk(hashtable, &hk);
+}
+
+/**
+ * @brief Check if key is present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_has_key_hk(hashtable_t *hashtable, hashtable_key_t *hk) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for reading */
+    unsigned long epoch = hashtable_lock_read(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+    if (HASHTABLE_LOCK_MUTEX == hashtable->config.lock) {
+        hashtable_rehash(hashtable, shard, 1);
+    }
+
+    /* Lookup for the wanted element */
+    bool found = (NULL != hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash));
+
+    /* Unlock shard */
+    hashtable_unlock_read(hashtable, shard, epoch);
+
+    return found;
+}
+
+/**
+ * @brief Get all keys of the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the hashtable (free required)
+ * @return Number of element of the hashtable
+ */
+size_t
+hashtable_get_keys(hashtable_t *hashtable, char ***keys) {
+
+    assert(NULL != hashtable);
+
+    size_t count = 0;
+
+    /* Lock all shards, always in the same order, elements must not be migrated while parsing the shards */
+    for (size_t index = 0; index < hashtable->config.shards; index++) {
+        if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+            hashtable_lock_write(hashtable, &hashtable->shards[index]);
+        } else {
+            hashtable_lock_read(hashtable, &hashtable->shards[index]);
+        }
+        count += hashtable->shards[index].count;
+    }
+
+    /* Check if at least one element is in the hashtable */
+    if (0 < count) {
+
+        /* Create table of keys */
+        if (NULL != (*keys = (char **)malloc(count * sizeof(char *)))) {
+
+            /* Parse shards and store keys */
+            char **cursor = *keys;
+            for (size_t index = 0; index < hashtable->config.shards; index++) {
+                hashtable_foreach(hashtable, &hashtable->shards[index], hashtable_get_keys_cb, &cursor);
+            }
+        }
+    }
+
+    /* Unlock all shards */
+    for (size_t index = 0; index < hashtable->config.shards; index++) {
+        if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+            hashtable_unlock(hashtable, &hashtable->shards[index]);
+        } else {
+            hashtable_unlock_read(hashtable, &hashtable->shards[index], 0);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Visit a bounded number of buckets of the hashtable, starting at the wanted cursor
+ * @param hashtable Hashtable instance
+ * @param cursor Cursor returned by the previous call, 0 to start a new scan
+ * @param count Number of buckets to visit, at least one
+ * @param fct Function called for each element of the visited buckets
+ * @param user User data given to the function
+ * @return Cursor to use for the next call, 0 if the scan is completed
+ */
+size_t
+hashtable_scan(hashtable_t *hashtable, size_t cursor, size_t count, hashtable_scan_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(0 < count);
+    assert(NULL != fct);
+
+    /* The cursor is made of the index of the shard and of the reverse binary cursor in the shard */
+    size_t   index = cursor % hashtable->config.shards;
+    uint64_t v     = cursor / hashtable->config.shards;
+
+    do {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+
+        /* Lock shard, elements must not be migrated while parsing the buckets */
+        if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+            hashtable_lock_write(hashtable, shard);
+        } else {
+            hashtable_lock_read(hashtable, shard);
+        }
+
+        /* Visit buckets of the shard */
+        do {
+            v = hashtable_scan_shard(hashtable, shard, v, fct, user);
+        } while ((0 != v) && (1 < count--));
+
+        /* Unlock shard */
+        if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+            hashtable_unlock(hashtable, shard);
+        } else {
+            hashtable_unlock_read(hashtable, shard, 0);
+        }
+
+        /* Continue with the next shard if all buckets of the shard have been visited */
+        if ((0 == v) && (++index == hashtable->config.shards)) {
+            return 0;
+        }
+    } while ((0 == v) && (1 < count--));
+
+    return (size_t)(v * hashtable->config.shards + index);
+}
+
+/**
+ * @brief Take a point-in-time view of the hashtable, which can be parsed while the hashtable is modified
+ * @param hashtable Hashtable instance
+ * @return Snapshot of the hashtable if the function succeeded, NULL otherwise
+ */
+hashtable_snapshot_t *
+hashtable_snapshot(hashtable_t *hashtable) {
+
+    assert(NULL != hashtable);
+
+    /* Create snapshot with the cuts of the shards */
+    size_t                shards   = hashtable->config.shards;
+    hashtable_snapshot_t *snapshot = (hashtable_snapshot_t *)malloc(sizeof(hashtable_snapshot_t) + shards * (sizeof(hashtable_cut_t) + sizeof(char *)));
+    if (NULL == snapshot) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+    snapshot->hashtable = hashtable;
+    snapshot->count     = 0;
+    snapshot->items     = NULL;
+    snapshot->cuts      = (hashtable_cut_t *)(snapshot + 1);
+    snapshot->keys      = (char **)(snapshot->cuts + shards);
+    for (size_t index = 0; index < shards; index++) {
+        snapshot->cuts[index].version = UINT64_MAX;
+        snapshot->cuts[index].pending = true;
+        snapshot->keys[index]         = NULL;
+    }
+
+    /* Counters are incremented by lock-free readers in HASHTABLE_LOCK_RCU mode, the cuts are registered first so that the next readers lock the shard
+     * and record their modifications, the versions of the shards are read once the other readers are done */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        for (size_t index = 0; index < shards; index++) {
+            hashtable_shard_t *shard = &hashtable->shards[index];
+            hashtable_lock_write(hashtable, shard);
+            snapshot->cuts[index].next = shard->cuts;
+            shard->cuts                = &snapshot->cuts[index];
+            __atomic_store_n(&shard->pending, shard->pending + 1, __ATOMIC_SEQ_CST);
+            hashtable_unlock(hashtable, shard);
+        }
+        unsigned long epoch = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST) < epoch + 2) {
+            hashtable_epoch_advance(hashtable);
+        }
+    }
+
+    /* Lock all shards, always in the same order, only to read their versions so that the view is consistent across shards */
+    for (size_t index = 0; index < shards; index++) {
+        hashtable_lock_write(hashtable, &hashtable->shards[index]);
+    }
+    for (size_t index = 0; index < shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+        if (HASHTABLE_LOCK_RCU != hashtable->config.lock) {
+            snapshot->cuts[index].next = shard->cuts;
+            shard->cuts                = &snapshot->cuts[index];
+            __atomic_store_n(&shard->pending, shard->pending + 1, __ATOMIC_SEQ_CST);
+        }
+        snapshot->cuts[index].version = __atomic_load_n(&shard->version, __ATOMIC_RELAXED);
+    }
+    for (size_t index = 0; index < shards; index++) {
+        hashtable_unlock(hashtable, &hashtable->shards[index]);
+    }
+
+    /* Store the elements of the shards one after the other, elements modified in the meantime are stored as they were at the cut */
+    for (size_t index = 0; index < shards; index++) {
+        hashtable_shard_t *shard = &hashtable->shards[index];
+        hashtable_lock_write(hashtable, shard);
+        int ret = hashtable_snapshot_shard(hashtable, shard, snapshot, index);
+        hashtable_unlock(hashtable, shard);
+        if (0 != ret) {
+            /* Unable to allocate memory */
+            hashtable_snapshot_release(snapshot);
+            return NULL;
+        }
+    }
+
+    return snapshot;
+}
+
+/**
+ * @brief Get number of elements of the snapshot
+ * @param snapshot Snapshot of the hashtable
+ * @return Number of elements of the snapshot
+ */
+size_t
+hashtable_snapshot_get_count(hashtable_snapshot_t *snapshot) {
+
+    assert(NULL != snapshot);
+
+    return snapshot->count;
+}
+
+/**
+ * @brief Get element of the snapshot
+ * @param snapshot Snapshot of the hashtable
+ * @param index Index of the element, lower than the number of elements of the snapshot
+ * @param key Key of the element, valid until the snapshot is released, may be NULL
+ * @param key_len Length of the key in bytes, may be NULL
+ * @param e Element itself when the snapshot has been taken, may be NULL
+ * @return true if the element exists, false otherwise
+ */
+bool
+hashtable_snapshot_get(hashtable_snapshot_t *snapshot, size_t index, const char **key, size_t *key_len, void **e) {
+
+    assert(NULL != snapshot);
+
+    /* Check index of the element */
+    if (index >= snapshot->count) {
+        return false;
+    }
+
+    /* Retrieve the element, its key and counters are copied by the snapshot and values are not released while the snapshot exists */
+    hashtable_snapshot_item_t *item = &snapshot->items[index];
+    if (NULL != key) {
+        *key = item->key;
+    }
+    if (NULL != key_len) {
+        *key_len = item->key_len;
+    }
+    if (NULL != e) {
+        *e = item->e;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Release snapshot of the hashtable, it must be released before the hashtable
+ * @param snapshot Snapshot of the hashtable
+ */
+void
+hashtable_snapshot_release(hashtable_snapshot_t *snapshot) {
+
+    /* Release snapshot */
+    if (NULL != snapshot) {
+        hashtable_t *hashtable = snapshot->hashtable;
+
+        /* Remove the cuts from the shards, memory blocks which were only referenced by the snapshot can be released */
+        for (size_t index = 0; index < hashtable->config.shards; index++) {
+            hashtable_shard_t *shard = &hashtable->shards[index];
+            hashtable_lock_write(hashtable, shard);
+            hashtable_cut_t **link = &shard->cuts;
+            while (&snapshot->cuts[index] != *link) {
+                link = &(*link)->next;
+            }
+            *link = snapshot->cuts[index].next;
+            if (true == snapshot->cuts[index].pending) {
+                hashtable_snapshot_done(hashtable, shard, &snapshot->cuts[index]);
+            } else {
+                hashtable_unpin(hashtable, shard);
+            }
+            hashtable_unlock(hashtable, shard);
+            free(snapshot->keys[index]);
+        }
+
+        /* Release the references of the snapshot */
+        for (size_t index = 0; (true == hashtable->config.refcount) && (index < snapshot->count); index++) {
+            if (NULL != snapshot->items[index].e) {
+                hashtable_value_put(hashtable, snapshot->items[index].e);
+            }
+        }
+        free(snapshot->items);
+        free(snapshot);
+    }
+}
+
+/**
+ * @brief Lookup element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup(hashtable_t *hashtable, char *key) {
+
+    assert(NULL != key);
+
+    return hashtable_lookup_n(hashtable, key, strlen(key));
+}
+
+/**
+ * @brief Lookup element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup_n(hashtable_t *hashtable, const void *key, size_t key_len) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_lookup_hk(hashtable, &hk);
+}
+
+/**
+ * @brief Lookup element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup_hk(hashtable_t *hashtable, hashtable_key_t *hk) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    void *e = NULL;
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for reading */
+    unsigned long epoch = hashtable_lock_read(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+    if (HASHTABLE_LOCK_MUTEX == hashtable->config.lock) {
+        hashtable_rehash(hashtable, shard, 1);
+    }
+
+    /* Lookup for the wanted element */
+    hashtable_element_t *curr = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    if (NULL != curr) {
+        e = hashtable_value_get(hashtable, curr);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock_read(hashtable, shard, epoch);
+
+    return e;
+}
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+int
+hashtable_lookup_copy(hashtable_t *hashtable, char *key, void *buf, size_t buflen, size_t *size) {
+
+    assert(NULL != key);
+
+    return hashtable_lookup_copy_n(hashtable, key, strlen(key), buf, buflen, size);
+}
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+int
+hashtable_lookup_copy_n(hashtable_t *hashtable, const void *key, size_t key_len, void *buf, size_t buflen, size_t *size) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_lookup_copy_hk(hashtable, &hk, buf, buflen, size);
+}
+
+/**
+ * @brief Lookup element of the hashtable and copy its value into a buffer while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param buf Buffer receiving the value, truncated to buflen bytes, may be NULL if buflen is 0
+ * @param buflen Size of the buffer in bytes
+ * @param size Size of the value stored in the hashtable, greater than buflen if the value is truncated, may be NULL
+ * @return 0 if the function succeeded, -1 if the key is not found
+ */
+int
+hashtable_lookup_copy_hk(hashtable_t *hashtable, hashtable_key_t *hk, void *buf, size_t buflen, size_t *size) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert((NULL != buf) || (0 == buflen));
+
+    int ret = -1;
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard, lock-free readers could see the size and the value of the element being updated independently */
+    unsigned long epoch = 0;
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        hashtable_lock_write(hashtable, shard);
+    } else {
+        epoch = hashtable_lock_read(hashtable, shard);
+    }
+
+    /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+    if (HASHTABLE_LOCK_RWLOCK != hashtable->config.lock) {
+        hashtable_rehash(hashtable, shard, 1);
+    }
+
+    /* Lookup for the wanted element */
+    hashtable_element_t *curr = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    if (NULL != curr) {
+
+        /* Copy the value, counters may be incremented concurrently by other readers */
+        int64_t *counter = hashtable_element_counter(curr);
+        if ((NULL != counter) && (0 != buflen)) {
+            int64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+            memcpy(buf, &value, (buflen < sizeof(value)) ? buflen : sizeof(value));
+        } else if ((NULL == counter) && (NULL != curr->e) && (0 != buflen)) {
+            memcpy(buf, curr->e, (buflen < curr->size) ? buflen : curr->size);
+        }
+        if (NULL != size) {
+            *size = curr->size;
+        }
+        ret = 0;
+    }
+
+    /* Unlock shard */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        hashtable_unlock(hashtable, shard);
+    } else {
+        hashtable_unlock_read(hashtable, shard, epoch);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+int
+hashtable_with_value(hashtable_t *hashtable, char *key, hashtable_value_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    return hashtable_with_value_n(hashtable, key, strlen(key), fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+int
+hashtable_with_value_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_value_fct_t fct, void *user) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_with_value_hk(hashtable, &hk, fct, user);
+}
+
+/**
+ * @brief Lookup element of the hashtable and call a function with it while the shard is locked
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param fct Function called with the element while the shard is locked for writing
+ * @param user User data given to the function
+ * @return 0 if the key is found, -1 if it is not found or if memory can not be allocated while snapshots include its value
+ */
+int
+hashtable_with_value_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_value_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != fct);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing, so that the element can be modified in place */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Lookup for the wanted element and call the function with it, values included in snapshots are not modified in place: the function is called with
+     * a private copy which then replaces the value, the element keeps its expiration */
+    int                  ret  = -1;
+    hashtable_element_t *curr = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    if ((NULL != curr) && (true == hashtable_value_shared(hashtable, shard, curr))) {
+        uint64_t expire = curr->expire;
+        void *   copy   = malloc(curr->size);
+        if (NULL != copy) {
+            memcpy(copy, curr->e, curr->size);
+            fct(curr->key, curr->key_len, copy, curr->size, user);
+            if ((0 == (ret = hashtable_update(hashtable, shard, curr, copy, curr->size, NULL))) && (0 != expire)) {
+                __atomic_store_n(&curr->expire, expire, __ATOMIC_RELAXED);
+                hashtable_timer_add(shard->wheel, curr);
+            }
+            free(copy);
+        }
+    } else if ((NULL != curr) && (0 == hashtable_retire_reserve(hashtable, shard, 0))) {
+        /* Counters are recorded first if snapshots of the shard are pending */
+        hashtable_history_record(hashtable, shard, curr);
+        fct(curr->key, curr->key_len, curr->e, curr->size, user);
+        hashtable_element_version(shard, curr);
+        ret = 0;
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return ret;
+}
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup_versioned(hashtable_t *hashtable, char *key, uint64_t *version) {
+
+    assert(NULL != key);
+
+    return hashtable_lookup_versioned_n(hashtable, key, strlen(key), version);
+}
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup_versioned_n(hashtable_t *hashtable, const void *key, size_t key_len, uint64_t *version) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_lookup_versioned_hk(hashtable, &hk, version);
+}
+
+/**
+ * @brief Lookup element of the hashtable and get its version
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param version Version of the element, 0 if not found
+ * @return Element of the hashtable, NULL if not found
+ */
+void *
+hashtable_lookup_versioned_hk(hashtable_t *hashtable, hashtable_key_t *hk, uint64_t *version) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != version);
+
+    void *e = NULL;
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for reading */
+    unsigned long epoch = hashtable_lock_read(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+    if (HASHTABLE_LOCK_MUTEX == hashtable->config.lock) {
+        hashtable_rehash(hashtable, shard, 1);
+    }
+
+    /* Lookup for the wanted element, the version is read first so that a value replaced in the meantime can not be given with its new version */
+    *version                  = 0;
+    hashtable_element_t *curr = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    if (NULL != curr) {
+        *version = __atomic_load_n(&curr->version, __ATOMIC_ACQUIRE);
+        e        = hashtable_value_get(hashtable, curr);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock_read(hashtable, shard, epoch);
+
+    return e;
+}
+
+/**
+ * @brief Lookup several elements of the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param values Elements of the hashtable, NULL if not found
+ * @return Number of keys found in the hashtable
+ */
+size_t
+hashtable_lookup_batch(hashtable_t *hashtable, char **keys, size_t n, void **values) {
+
+    assert(NULL != hashtable);
+    assert((NULL != keys) || (0 == n));
+    assert((NULL != values) || (0 == n));
+
+    return hashtable_lookup_many(hashtable, keys, n, values, NULL);
+}
+
+/**
+ * @brief Check if several keys are present in the hashtable
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param bitmap Bitmap of the keys found in the hashtable, bit N % 8 of byte N / 8 being set if keys[N] is found
+ * @return Number of keys found in the hashtable
+ */
+size_t
+hashtable_has_key_batch(hashtable_t *hashtable, char **keys, size_t n, uint8_t *bitmap) {
+
+    assert(NULL != hashtable);
+    assert((NULL != keys) || (0 == n));
+    assert((NULL != bitmap) || (0 == n));
+
+    return hashtable_lookup_many(hashtable, keys, n, NULL, bitmap);
+}
+
+/**
+ * @brief Remove element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
+ */
+void *
+hashtable_remove(hashtable_t *hashtable, char *key) {
+
+    assert(NULL != key);
+
+    return hashtable_remove_n(hashtable, key, strlen(key));
+}
+
+/**
+ * @brief Remove element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
+ */
+void *
+hashtable_remove_n(hashtable_t *hashtable, const void *key, size_t key_len) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_remove_hk(hashtable, &hk);
+}
+
+/**
+ * @brief Remove element of the hashtable
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @return Head element of the hashtable, NULL if not found or if memory can not be allocated while snapshots exist
+ */
+void *
+hashtable_remove_hk(hashtable_t *hashtable, hashtable_key_t *hk) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    void *e = NULL;
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Lookup for the wanted element and unlink it, its value is copied first if snapshots reference it */
+    void *copy = NULL;
+    int   ret  = hashtable_retire_reserve(hashtable, shard, 2);
+    if ((0 == ret) && (NULL != shard->cuts)) {
+        ret = hashtable_value_detach_copy(hashtable, shard, hashtable_search(hashtable, shard, hk->key, hk->key_len, hash), &copy);
+    }
+    hashtable_element_t *curr  = (0 == ret) ? hashtable_unlink(hashtable, shard, hk->key, hk->key_len, hash) : NULL;
+    bool                 found = (NULL != curr);
+    if (true == found) {
+        e = hashtable_value_detach(hashtable, shard, hashtable_element_value(curr), __atomic_load_n(&curr->version, __ATOMIC_RELAXED), copy);
+        __atomic_store_n(&shard->count, shard->count - 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&shard->bytes, shard->bytes - hashtable_element_bytes(curr), __ATOMIC_RELAXED);
+        /* Release memory */
+        hashtable_retire(hashtable, shard, curr, HASHTABLE_RETIRED_ELEMENT, 0);
+    }
+
+    /* Check if the shard should be resized */
+    if (true == found) {
+        hashtable_check_load(hashtable, shard);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return e;
+}
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_find(hashtable_t *hashtable, char *key, hashtable_entry_t *entry) {
+
+    assert(NULL != key);
+
+    return hashtable_find_n(hashtable, key, strlen(key), entry);
+}
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param key Key of the element, binary data which is not required to be NUL-terminated
+ * @param key_len Length of the key in bytes
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_find_n(hashtable_t *hashtable, const void *key, size_t key_len, hashtable_entry_t *entry) {
+
+    assert(NULL != key);
+
+    /* Compute hash value of the wanted key */
+    hashtable_key_t hk;
+    hashtable_key_init(hashtable, &hk, key, key_len);
+
+    return hashtable_find_hk(hashtable, &hk, entry);
+}
+
+/**
+ * @brief Lookup element of the hashtable and get an entry which can be used to update or remove it without looking it up again
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element, initialized with hashtable_key_init
+ * @param entry Entry of the element
+ * @return true if the key is found, false otherwise
+ */
+bool
+hashtable_find_hk(hashtable_t *hashtable, hashtable_key_t *hk, hashtable_entry_t *entry) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert(NULL != entry);
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for reading */
+    unsigned long epoch = hashtable_lock_read(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+    if (HASHTABLE_LOCK_MUTEX == hashtable->config.lock) {
+        hashtable_rehash(hashtable, shard, 1);
+    }
+
+    /* Lookup for the wanted element, the generation is read first so that an element removed in the meantime invalidates the entry */
+    entry->shard      = shard;
+    entry->generation = __atomic_load_n(&shard->generation, __ATOMIC_ACQUIRE);
+    entry->element    = hashtable_find_read(hashtable, shard, hk->key, hk->key_len, hash);
+    entry->e          = (NULL != entry->element) ? hashtable_value_get(hashtable, entry->element) : NULL;
+
+    /* Unlock shard */
+    hashtable_unlock_read(hashtable, shard, epoch);
+
+    return (NULL != entry->element);
+}
+
+/**
+ * @brief Replace the element of an entry
+ * @param hashtable Hashtable instance
+ * @param entry Entry of the element, returned by hashtable_find
+ * @param e Element to be stored in the hashtable
+ * @param size Size of the element to be stored
+ * @return 0 if the function succeeded, -1 if the entry is not valid anymore or if memory can not be allocated
+ */
+int
+hashtable_entry_set_value(hashtable_t *hashtable, hashtable_entry_t *entry, void *e, size_t size) {
+
+    assert(NULL != hashtable);
+    assert(NULL != entry);
+
+    int ret = -1;
+
+    /* Nothing to do if the element has not been found */
+    if (NULL == entry->element) {
+        return -1;
+    }
+
+    /* Lock shard for writing */
+    hashtable_lock_write(hashtable, entry->shard);
+
+    /* Replace the element if no element of the shard has been removed since the entry has been retrieved */
+    if (entry->generation == entry->shard->generation) {
+        if (0 == (ret = hashtable_update(hashtable, entry->shard, entry->element, e, size, NULL))) {
+            /* The reference of the entry to the previous value is released, readers may still access it through the reference of the hashtable */
+            if ((true == hashtable->config.refcount) && (NULL != entry->e)) {
+                hashtable_value_put(hashtable, entry->e);
+            }
+            entry->e = hashtable_value_get(hashtable, entry->element);
+        }
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, entry->shard);
+
+    return ret;
+}
+
+/**
+ * @brief Remove the element of an entry
+ * @param hashtable Hashtable instance
+ * @param entry Entry of the element, returned by hashtable_find, it is not valid anymore and its reference to the value is released in any case
+ * @param e Element removed from the hashtable, may be NULL in which case the element is released in alloc mode
+ * @return 0 if the function succeeded, -1 if the entry is not valid anymore or if memory can not be allocated while snapshots exist
+ */
+int
+hashtable_entry_remove(hashtable_t *hashtable, hashtable_entry_t *entry, void **e) {
+
+    assert(NULL != hashtable);
+    assert(NULL != entry);
+
+    hashtable_element_t *curr = NULL;
+
+    /* Nothing to do if the element has not been found */
+    if (NULL == entry->element) {
+        return -1;
+    }
+
+    /* Lock shard for writing */
+    hashtable_shard_t *shard = entry->shard;
+    hashtable_lock_write(hashtable, shard);
+
+    /* Unlink the element if no element of the shard has been removed since the entry has been retrieved */
+    void *copy = NULL;
+    if ((entry->generation == shard->generation) && (0 == hashtable_retire_reserve(hashtable, shard, 2))
+        && ((NULL == e) || (0 == hashtable_value_detach_copy(hashtable, shard, entry->element, &copy)))) {
+        curr = hashtable_unlink(hashtable, shard, entry->element->key, entry->element->key_len, entry->element->hash);
+        assert(curr == entry->element);
+        void *value = hashtable_element_value(curr);
+        if (NULL != e) {
+            *e = hashtable_value_detach(hashtable, shard, value, __atomic_load_n(&curr->version, __ATOMIC_RELAXED), copy);
+        } else if ((true == hashtable->config.alloc) && (NULL != value)) {
+            hashtable_retire(hashtable, shard, value, HASHTABLE_RETIRED_VALUE, __atomic_load_n(&curr->version, __ATOMIC_RELAXED));
+        }
+        __atomic_store_n(&shard->count, shard->count - 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&shard->bytes, shard->bytes - hashtable_element_bytes(curr), __ATOMIC_RELAXED);
+        /* Release memory */
+        hashtable_retire(hashtable, shard, curr, HASHTABLE_RETIRED_ELEMENT, 0);
+        /* Check if the shard should be resized */
+        hashtable_check_load(hashtable, shard);
+    }
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    /* The entry is not valid anymore, its reference to the value is released whether the element has been removed or not */
+    if ((true == hashtable->config.refcount) && (NULL != entry->e)) {
+        hashtable_value_put(hashtable, entry->e);
+    }
+    entry->element = NULL;
+    entry->e       = NULL;
+
+    return (NULL != curr) ? 0 : -1;
+}
+
+/**
+ * @brief Release a value returned by the hashtable, the value is released with its last reference if values are reference counted
+ * @param hashtable Hashtable instance
+ * @param e Value returned by the hashtable, may be NULL
+ */
+void
+hashtable_value_release(hashtable_t *hashtable, void *e) {
+
+    assert(NULL != hashtable);
+
+    /* Nothing to do if there is no value or if values are not owned by the hashtable */
+    if ((NULL == e) || (false == hashtable->config.alloc)) {
+        return;
+    }
+
+    /* Release the value or the reference without locking, lock-free readers can not be taking the last reference: the reference of the hashtable to a
+     * value removed or replaced is only released once they are done */
+    hashtable_value_put(hashtable, e);
+}
+
+/**
+ * @brief Release hashtable instance
+ * @param hashtable Hashtable instance
+ */
+void
+hashtable_release(hashtable_t *hashtable) {
+
+    /* Release hashtable instance */
+    if (NULL != hashtable) {
+
+        /* Release shards */
+        for (size_t s = 0; (NULL != hashtable->shards) && (s < hashtable->config.shards); s++) {
+            hashtable_shard_t *shard = &hashtable->shards[s];
+
+            /* Lock shard for writing */
+            hashtable_lock_write(hashtable, shard);
+
+            /* Release shard elements and tables */
+            hashtable_foreach(hashtable, shard, hashtable_release_cb, hashtable);
+            free(shard->table[0]);
+            free(shard->table[1]);
+            free(shard->wheel);
+            free(shard->sketch);
+
+            /* Release retired memory blocks, readers must not access the hashtable anymore */
+            while (NULL != shard->retired) {
+                hashtable_retired_t *tmp = shard->retired;
+                shard->retired           = shard->retired->next;
+                hashtable_retired_free(hashtable, tmp->ptr, tmp->type);
+                free(tmp);
+            }
+            while (NULL != shard->spare) {
+                hashtable_retired_t *tmp = shard->spare;
+                shard->spare             = shard->spare->next;
+                free(tmp);
+            }
+            free(shard->history_spare);
+
+            /* Release semaphore or read-write lock */
+            hashtable_unlock(hashtable, shard);
+            if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+                pthread_rwlock_destroy(&shard->rwlock);
+            } else {
+                sem_close(&shard->sem);
+            }
+            pthread_mutex_destroy(&shard->loads_mutex);
+        }
+
+        /* Release shards and reader slots */
+        free(hashtable->shards);
+        free(hashtable->slots);
+
+        /* Release hashtable instance */
+        free(hashtable);
+    }
+}
+
+/**
+ * @brief Initialize the keys of the hash function, from the configured seed or from a random source
+ * @param hashtable Hashtable instance
+ */
+static void
+hashtable_init_seed(hashtable_t *hashtable) {
+
+    assert(NULL != hashtable);
+
+    /* Derive both keys from the configured seed */
+    if (0 != hashtable->config.seed) {
+        hashtable->seed[0] = hashtable->config.seed;
+        hashtable->seed[1] = hashtable_mix(hashtable->config.seed ^ 0x9E3779B97F4A7C15ULL);
+        return;
+    }
+
+    /* Read random keys, the time and the address of the hashtable are used if no random source is available */
+    FILE *f = fopen("/dev/urandom", "rb");
+    if ((NULL == f) || (1 != fread(hashtable->seed, sizeof(hashtable->seed), 1, f))) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        hashtable->seed[0] = hashtable_mix((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
+        hashtable->seed[1] = hashtable_mix(hashtable->seed[0] ^ (uint64_t)(uintptr_t)hashtable);
+    }
+    if (NULL != f) {
+        fclose(f);
+    }
+}
+
+/**
+ * @brief Compute hash value of the wanted key with the hash function of the hashtable
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @return Hash value of the key
+ */
+static uint64_t
+hashtable_compute_hash(hashtable_t *hashtable, const void *key, size_t key_len) {
+
+    assert(NULL != hashtable);
+    assert(NULL != key);
+
+    /* Call the custom hash function or the wanted hash function */
+    if (NULL != hashtable->config.hash_fct) {
+        return hashtable->config.hash_fct(key, key_len, hashtable->seed[0]);
+    }
+    switch (hashtable->config.hash) {
+        case HASHTABLE_HASH_DJB2:
+            return hashtable_hash_djb2(key, key_len);
+        case HASHTABLE_HASH_SIPHASH:
+            return hashtable_hash_siphash(key, key_len, hashtable->seed[0], hashtable->seed[1]);
+        default:
+            return hashtable_hash_wyhash(key, key_len, hashtable->seed[0]);
+    }
+}
+
+/**
+ * @brief Get hash value of the pre-hashed key, which is computed again if the key has been hashed with another hash function
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key
+ * @return Hash value of the key
+ */
+static uint64_t
+hashtable_key_hash(hashtable_t *hashtable, hashtable_key_t *hk) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+
+    /* Check the key has been hashed with the hash function of the hashtable */
+    if (hk->hash_id != hashtable->hash_id) {
+        hk->hash    = hashtable_compute_hash(hashtable, hk->key, hk->key_len);
+        hk->hash_id = hashtable->hash_id;
+    }
+
+    return hk->hash;
+}
+
+/**
+ * @brief Compute djb2 hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @return Hash value of the key
+ */
+static uint64_t
+hashtable_hash_djb2(const void *key, size_t key_len) {
+
+    assert(NULL != key);
+
+    /* Compute djb2 hash over the bytes of the key, the lowest bits are mixed since they select the list of elements */
+    const unsigned char *c    = (const unsigned char *)key;
+    uint64_t             hash = 5381;
+    while (0 < key_len--) {
+        hash = ((hash << 5) + hash) + *c++; /* hash * 33 + c */
+    }
+
+    return hashtable_mix(hash);
+}
+
+/**
+ * @brief Read up to 8 bytes of the key as an integer
+ * @param p Bytes of the key
+ * @param len Number of bytes to be read
+ * @return Integer value
+ */
+static uint64_t
+hashtable_hash_read(const uint8_t *p, size_t len) {
+
+    assert(NULL != p);
+    assert(8 >= len);
+
+    /* Copy bytes, the compiler replaces the copy by a single load for constant lengths */
+    uint64_t value = 0;
+    memcpy(&value, p, len);
+
+    return value;
+}
+
+/**
+ * @brief Multiply two 64 bits integers, the 128 bits result is split between the two integers
+ * @param a First integer, replaced by the lowest 64 bits of the result
+ * @param b Second integer, replaced by the highest 64 bits of the result
+ */
+static void
+hashtable_hash_mum(uint64_t *a, uint64_t *b) {
+
+    assert(NULL != a);
+    assert(NULL != b);
+
+#if defined(__SIZEOF_INT128__)
+    /* Native 128 bits multiplication */
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a            = (uint64_t)r;
+    *b            = (uint64_t)(r >> 64);
+#else
+    /* Multiplication of 32 bits halves */
+    uint64_t ha = *a >> 32, la = (uint32_t)*a, hb = *b >> 32, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = (t < rl);
+    uint64_t lo = t + (rm1 << 32);
+    c += (lo < t);
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * @brief Compute wyhash hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param seed Seed of the hash function
+ * @return Hash value of the key
+ */
+static uint64_t
+hashtable_hash_wyhash(const void *key, size_t key_len, uint64_t seed) {
+
+    assert(NULL != key);
+
+    static const uint64_t secret[4] = { 0x2D358DCCAA6C78A5ULL, 0x8BB84B93962EACC9ULL, 0x4B33A62ED433D4A3ULL, 0x4D5A2DA51DE1AA47ULL };
+    const uint8_t *       p         = (const uint8_t *)key;
+    uint64_t              a, b;
+
+    /* Mix the seed with the secret */
+    a = seed ^ secret[0];
+    b = secret[1];
+    hashtable_hash_mum(&a, &b);
+    seed ^= a ^ b;
+
+    /* Read the key, short keys are read with overlapping loads and longer keys 48 then 16 bytes at a time */
+    if (16 >= key_len) {
+        if (4 <= key_len) {
+            a = (hashtable_hash_read(p, 4) << 32) | hashtable_hash_read(p + ((key_len >> 3) << 2), 4);
+            b = (hashtable_hash_read(p + key_len - 4, 4) << 32) | hashtable_hash_read(p + key_len - 4 - ((key_len >> 3) << 2), 4);
+        } else if (0 < key_len) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[key_len >> 1] << 8) | p[key_len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t len = key_len;
+        if (48 < len) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                a = hashtable_hash_read(p, 8) ^ secret[1];
+                b = hashtable_hash_read(p + 8, 8) ^ seed;
+                hashtable_hash_mum(&a, &b);
+                seed = a ^ b;
+                a    = hashtable_hash_read(p + 16, 8) ^ secret[2];
+                b    = hashtable_hash_read(p + 24, 8) ^ see1;
+                hashtable_hash_mum(&a, &b);
+                see1 = a ^ b;
+                a    = hashtable_hash_read(p + 32, 8) ^ secret[3];
+                b    = hashtable_hash_read(p + 40, 8) ^ see2;
+                hashtable_hash_mum(&a, &b);
+                see2 = a ^ b;
+                p += 48;
+                len -= 48;
+            } while (48 < len);
+            seed ^= see1 ^ see2;
+        }
+        while (16 < len) {
+            a = hashtable_hash_read(p, 8) ^ secret[1];
+            b = hashtable_hash_read(p + 8, 8) ^ seed;
+            hashtable_hash_mum(&a, &b);
+            seed = a ^ b;
+            p += 16;
+            len -= 16;
+        }
+        a = hashtable_hash_read(p + len - 16, 8);
+        b = hashtable_hash_read(p + len - 8, 8);
+    }
+
+    /* Finalize */
+    a ^= secret[1];
+    b ^= seed;
+    hashtable_hash_mum(&a, &b);
+    a ^= secret[0] ^ key_len;
+    b ^= secret[1];
+    hashtable_hash_mum(&a, &b);
+
+    return a ^ b;
+}
+
+/**
+ * @brief Perform SipHash rounds on the internal state
+ * @param v Internal state
+ * @param rounds Number of rounds
+ */
+static void
+hashtable_hash_sipround(uint64_t v[4], int rounds) {
+
+    assert(NULL != v);
+
+    while (0 < rounds--) {
+        v[0] += v[1];
+        v[1] = (v[1] << 13) | (v[1] >> 51);
+        v[1] ^= v[0];
+        v[0] = (v[0] << 32) | (v[0] >> 32);
+        v[2] += v[3];
+        v[3] = (v[3] << 16) | (v[3] >> 48);
+        v[3] ^= v[2];
+        v[0] += v[3];
+        v[3] = (v[3] << 21) | (v[3] >> 43);
+        v[3] ^= v[0];
+        v[2] += v[1];
+        v[1] = (v[1] << 17) | (v[1] >> 47);
+        v[1] ^= v[2];
+        v[2] = (v[2] << 32) | (v[2] >> 32);
+    }
+}
+
+/**
+ * @brief Compute SipHash-1-3 hash value of the wanted key
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param k0 First half of the 128 bits key of the hash function
+ * @param k1 Second half of the 128 bits key of the hash function
+ * @return Hash value of the key
+ */
+static uint64_t
+hashtable_hash_siphash(const void *key, size_t key_len, uint64_t k0, uint64_t k1) {
+
+    assert(NULL != key);
+
+    const uint8_t *p    = (const uint8_t *)key;
+    uint64_t       v[4] = { 0x736F6D6570736575ULL ^ k0, 0x646F72616E646F6DULL ^ k1, 0x6C7967656E657261ULL ^ k0, 0x7465646279746573ULL ^ k1 };
+    uint64_t       m;
+
+    /* Compress the key 8 bytes at a time, with one round per word */
+    size_t len = key_len;
+    while (8 <= len) {
+        m = hashtable_hash_read(p, 8);
+        v[3] ^= m;
+        hashtable_hash_sipround(v, 1);
+        v[0] ^= m;
+        p += 8;
+        len -= 8;
+    }
+
+    /* Last word contains the remaining bytes and the length of the key */
+    m = hashtable_hash_read(p, len) | ((uint64_t)key_len << 56);
+    v[3] ^= m;
+    hashtable_hash_sipround(v, 1);
+    v[0] ^= m;
+
+    /* Finalize with three rounds */
+    v[2] ^= 0xFF;
+    hashtable_hash_sipround(v, 3);
+
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/**
+ * @brief Get the shard in which the wanted hash value is stored
+ * @param hashtable Hashtable instance
+ * @param hash Hash value of the key
+ * @return Shard of the hashtable
+ */
+static hashtable_shard_t *
+hashtable_get_shard(hashtable_t *hashtable, uint64_t hash) {
+
+    assert(NULL != hashtable);
+
+    /* Mix the hash value so that the shard index does not depend on the same bits than the list index */
+    uint64_t mix = (hash * 0x9E3779B97F4A7C15ULL) >> 32;
+
+    return &hashtable->shards[mix % hashtable->config.shards];
+}
+
+/**
+ * @brief Get the size of the memory allocated for an element and its key
+ * @param key_len Length of the key in bytes
+ * @return Size of the element, multiple of 8 bytes so that elements can be allocated contiguously
+ */
+static size_t
+hashtable_element_size(size_t key_len) {
+
+    /* Element is followed by the key and a NUL character */
+    return (sizeof(hashtable_element_t) + key_len + 1 + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Get the number of bytes used by an element, accounted in the memory of its shard
+ * @param element Element of the hashtable
+ * @return Size of the element with its key, plus the size of its value
+ */
+static size_t
+hashtable_element_bytes(hashtable_element_t *element) {
+
+    assert(NULL != element);
+
+    /* Counters are allocated right after the key, their size is the size of the value */
+    return hashtable_element_size(element->key_len) + element->size;
+}
+
+/**
+ * @brief Initialize element in the wanted memory, the key is copied right after the element
+ * @param hashtable Hashtable instance
+ * @param ptr Memory of the element, at least hashtable_element_size bytes
+ * @param block Block in which the element is allocated, NULL if the element is allocated alone
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @param e Element to be added in the hashtable
+ * @param size Size of the element to be added
+ * @return Element if the function succeeded, NULL otherwise
+ */
+static hashtable_element_t *
+hashtable_element_init(hashtable_t *hashtable, void *ptr, hashtable_block_t *block, const void *key, size_t key_len, uint64_t hash, void *e, size_t size) {
+
+    assert(NULL != hashtable);
+    assert(NULL != ptr);
+    assert(NULL != key);
+
+    hashtable_element_t *element = (hashtable_element_t *)ptr;
+    memset(element, 0, sizeof(hashtable_element_t));
+
+    /* Store key, a NUL character is appended so that string keys can be returned by hashtable_get_keys */
+    element->key = (char *)(element + 1);
+    memcpy(element->key, key, key_len);
+    element->key[key_len] = '\0';
+    element->key_len      = key_len;
+    element->hash         = hash;
+    element->block        = block;
+    element->size         = size;
+    element->referenced   = false;
+    element->expire       = 0;
+    element->timer_next   = NULL;
+    element->timer_prev   = NULL;
+
+    /* Store element */
+    if ((NULL == (element->e = hashtable_value_copy(hashtable, e, size))) && (NULL != e)) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+
+    return element;
+}
+
+/**
+ * @brief Get the counter stored in the element, allocated right after its key by hashtable_incr
+ * @param element Element of the hashtable
+ * @return Counter of the element, NULL if the element is not a counter
+ */
+static int64_t *
+hashtable_element_counter(hashtable_element_t *element) {
+
+    assert(NULL != element);
+
+    /* Counters are only allocated with elements which are not allocated in blocks */
+    int64_t *counter = (int64_t *)((char *)element + hashtable_element_size(element->key_len));
+    if ((NULL != element->block) || ((void *)counter != __atomic_load_n(&element->e, __ATOMIC_ACQUIRE))) {
+        return NULL;
+    }
+
+    return counter;
+}
+
+/**
+ * @brief Get the value of the element which can be given to the caller, counters are released with their element
+ * @param element Element of the hashtable
+ * @return Value of the element, NULL if the element is a counter
+ */
+static void *
+hashtable_element_value(hashtable_element_t *element) {
+
+    assert(NULL != element);
+
+    return (NULL != hashtable_element_counter(element)) ? NULL : element->e;
+}
+
+/**
+ * @brief Release memory of the element and its key, the value of the element is not released
+ * @param element Element of the hashtable
+ */
+static void
+hashtable_element_free(hashtable_element_t *element) {
+
+    assert(NULL != element);
+
+    /* Release the element or its reference to the block in which it is allocated */
+    if (NULL == element->block) {
+        free(element);
+    } else {
+        hashtable_block_release(element->block);
+    }
+}
+
+/**
+ * @brief Release a reference to a block of elements, the block is released with its last reference
+ * @param block Block of elements
+ */
+static void
+hashtable_block_release(hashtable_block_t *block) {
+
+    /* Elements of a block may be stored in different shards, the counter is shared between their locks */
+    if ((NULL != block) && (0 == __atomic_sub_fetch(&block->live, 1, __ATOMIC_ACQ_REL))) {
+        free(block);
+    }
+}
+
+/**
+ * @brief Copy a value to be stored in the hashtable in alloc mode, reference counted values are allocated after their header
+ * @param hashtable Hashtable instance
+ * @param e Value to be stored
+ * @param size Size of the value
+ * @return Value to be stored, which is e itself if it is not copied, NULL if memory can not be allocated
+ */
+static void *
+hashtable_value_copy(hashtable_t *hashtable, void *e, size_t size) {
+
+    assert(NULL != hashtable);
+
+    /* Values are only copied in alloc mode, reference counted values are copied even if empty so that they have a header */
+    if ((false == hashtable->config.alloc) || (NULL == e) || ((0 == size) && (false == hashtable->config.refcount))) {
+        return e;
+    }
+
+    /* Copy the value, the reference of the hashtable is the first one */
+    size_t header = (true == hashtable->config.refcount) ? sizeof(hashtable_value_t) : 0;
+    char * copy   = (char *)malloc(header + size);
+    if (NULL == copy) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+    if (true == hashtable->config.refcount) {
+        ((hashtable_value_t *)copy)->refs = 1;
+    }
+    memcpy(copy + header, e, size);
+
+    return copy + header;
+}
+
+/**
+ * @brief Get the value of an element to be returned to the caller, a reference is taken if values are reference counted
+ * @param hashtable Hashtable instance
+ * @param element Element of the hashtable, found while the shard is locked or in the current epoch
+ * @return Value of the element
+ */
+static void *
+hashtable_value_get(hashtable_t *hashtable, hashtable_element_t *element) {
+
+    assert(NULL != hashtable);
+    assert(NULL != element);
+
+    /* The reference of the hashtable is released after readers are done, so that the value can not be released in the meantime */
+    void *e = __atomic_load_n(&element->e, __ATOMIC_ACQUIRE);
+    if ((true == hashtable->config.refcount) && (NULL != e)) {
+        __atomic_add_fetch(&((hashtable_value_t *)e - 1)->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    return e;
+}
+
+/**
+ * @brief Release a value owned by the hashtable or a reference to it, which can not be accessed by readers anymore
+ * @param hashtable Hashtable instance
+ * @param e Value to be released
+ */
+static void
+hashtable_value_put(hashtable_t *hashtable, void *e) {
+
+    assert(NULL != hashtable);
+    assert(NULL != e);
+
+    /* Reference counted values are released with their last reference */
+    if (false == hashtable->config.refcount) {
+        free(e);
+    } else if (0 == __atomic_sub_fetch(&((hashtable_value_t *)e - 1)->refs, 1, __ATOMIC_ACQ_REL)) {
+        free((hashtable_value_t *)e - 1);
+    }
+}
+
+/**
+ * @brief Copy the value of an element in advance if it is referenced by snapshots, so that the value given to the caller once the element is removed or
+ * replaced can be released by the caller while the snapshots still access the stored one
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable, may be NULL
+ * @param copy Copy of the value, NULL if the value does not need to be copied
+ * @return 0 if the function succeeded, -1 if memory can not be allocated
+ */
+static int
+hashtable_value_detach_copy(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, void **copy) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != copy);
+
+    /* Only values owned by the hashtable without reference counter are copied, snapshots hold their own reference otherwise */
+    *copy = NULL;
+    if ((NULL == element) || (false == hashtable->config.alloc) || (true == hashtable->config.refcount) || (0 == element->size)
+        || (false == hashtable_snapshot_covers(shard, element->version, UINT64_MAX))) {
+        return 0;
+    }
+    void *e = hashtable_element_value(element);
+    if (NULL == e) {
+        return 0;
+    }
+    if (NULL == (*copy = hashtable_value_copy(hashtable, e, element->size))) {
+        /* Unable to allocate memory */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check if the value of an element may be included in a snapshot, in which case it must not be modified in place
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable
+ * @return true if the value may be included in a snapshot, false otherwise
+ */
+static bool
+hashtable_value_shared(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* Values of size 0 are not accessible, counters are copied by snapshots, and values belong to the caller in reference mode */
+    return (true == hashtable->config.alloc) && (0 != element->size) && (NULL == hashtable_element_counter(element))
+           && (true == hashtable_snapshot_covers(shard, element->version, UINT64_MAX));
+}
+
+/**
+ * @brief Give a value removed or replaced to the caller, the reference of the hashtable is released after lock-free readers are done
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param e Value removed or replaced, may be NULL
+ * @param version Version of the element when the value has been stored
+ * @param copy Copy of the value given instead while snapshots reference it, returned by hashtable_value_detach_copy, may be NULL
+ * @return Value given to the caller, with its own reference if values are reference counted
+ */
+static void *
+hashtable_value_detach(hashtable_t *hashtable, hashtable_shard_t *shard, void *e, uint64_t version, void *copy) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* The stored value is released once the snapshots including it are released, the caller gets the copy */
+    if (NULL != copy) {
+        assert(NULL != e);
+        hashtable_retire(hashtable, shard, e, HASHTABLE_RETIRED_VALUE, version);
+        return copy;
+    }
+
+    /* Lock-free readers may still be taking a reference, the caller gets a new one so that it can release it without waiting for them */
+    if ((true == hashtable->config.refcount) && (HASHTABLE_LOCK_RCU == hashtable->config.lock) && (NULL != e)) {
+        __atomic_add_fetch(&((hashtable_value_t *)e - 1)->refs, 1, __ATOMIC_RELAXED);
+        hashtable_retire(hashtable, shard, e, HASHTABLE_RETIRED_VALUE, version);
+    }
+
+    return e;
+}
+
+/**
+ * @brief Give a new version to the element once it has been modified, readers seeing the new version also see the new value
+ * @param shard Shard of the hashtable
+ * @param element Element of the hashtable
+ */
+static void
+hashtable_element_version(hashtable_shard_t *shard, hashtable_element_t *element) {
+
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* Versions are taken from the shard so that an element removed and added again does not get a previous version */
+    __atomic_store_n(&element->version, __atomic_add_fetch(&shard->version, 1, __ATOMIC_RELAXED), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Replace the value of an existing element
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the hashtable
+ * @param e New element to be stored in the hashtable
+ * @param size Size of the new element
+ * @param prev Previous element, given to the caller instead of being released, may be NULL
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int
+hashtable_update(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, void *e, size_t size, void **prev) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* Elements larger than the memory of the shard can not be stored */
+    if ((0 != shard->memory) && (hashtable_element_size(element->key_len) + size > shard->memory)) {
+        return -1;
+    }
+
+    /* Copy the new element */
+    void *copy      = hashtable_value_copy(hashtable, e, size);
+    void *prev_copy = NULL;
+    if (((NULL == copy) && (NULL != e)) || (0 != hashtable_retire_reserve(hashtable, shard, 1))
+        || ((NULL != prev) && (0 != hashtable_value_detach_copy(hashtable, shard, element, &prev_copy)))) {
+        /* Unable to allocate memory */
+        if ((true == hashtable->config.alloc) && (NULL != copy)) {
+            hashtable_value_put(hashtable, copy);
+        }
+        return -1;
+    }
+    e = copy;
+
+    /* Evict other elements if the element grows beyond the memory of the shard, the memory used by evictions is allocated again */
+    if (((size > element->size) && (0 != hashtable_make_room(hashtable, shard, size - element->size, element)))
+        || (0 != hashtable_retire_reserve(hashtable, shard, 1))) {
+        /* Unable to allocate memory */
+        if ((true == hashtable->config.alloc) && (NULL != e)) {
+            hashtable_value_put(hashtable, e);
+        }
+        if (NULL != prev_copy) {
+            hashtable_value_put(hashtable, prev_copy);
+        }
+        return -1;
+    }
+    __atomic_store_n(&shard->bytes, shard->bytes - element->size + size, __ATOMIC_RELAXED);
+    element->size = size;
+
+    /* The element does not expire anymore */
+    hashtable_timer_remove(shard->wheel, element);
+    __atomic_store_n(&element->expire, 0, __ATOMIC_RELAXED);
+
+    /* Replace the element, the previous one may still be accessed by readers and by snapshots */
+    void *   old     = hashtable_element_value(element);
+    uint64_t version = __atomic_load_n(&element->version, __ATOMIC_RELAXED);
+    hashtable_history_record(hashtable, shard, element);
+    __atomic_store_n(&element->e, e, __ATOMIC_RELEASE);
+    hashtable_element_version(shard, element);
+    if (NULL != prev) {
+        *prev = hashtable_value_detach(hashtable, shard, old, version, prev_copy);
+    } else if ((true == hashtable->config.alloc) && (NULL != old)) {
+        hashtable_retire(hashtable, shard, old, HASHTABLE_RETIRED_VALUE, version);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Create new element and insert it in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param hk Pre-hashed key of the element
+ * @param hash Hash value of the key
+ * @param e Element to be stored in the hashtable
+ * @param size Size of the element to be stored
+ * @param counter Initial value of the counter stored in the element instead of e, NULL if the element is not a counter
+ * @return Element of the shard if the function succeeded, NULL otherwise
+ */
+static hashtable_element_t *
+hashtable_add_element(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_key_t *hk, uint64_t hash, void *e, size_t size, int64_t *counter) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != hk);
+
+    /* Elements larger than the memory of the shard can not be added, counters are accounted as values */
+    size = (NULL != counter) ? sizeof(int64_t) : size;
+    if ((0 != shard->memory) && (hashtable_element_size(hk->key_len) + size > shard->memory)) {
+        return NULL;
+    }
+
+    /* Create a new hashtable element, the key and the counter are allocated with the element */
+    void *ptr = malloc(hashtable_element_size(hk->key_len) + ((NULL != counter) ? sizeof(int64_t) : 0));
+    if (NULL == ptr) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+    hashtable_element_t *element = hashtable_element_init(hashtable, ptr, NULL, hk->key, hk->key_len, hash, (NULL != counter) ? NULL : e, size);
+    if (NULL == element) {
+        /* Unable to allocate memory */
+        free(ptr);
+        return NULL;
+    }
+    if (NULL != counter) {
+        int64_t *value = (int64_t *)((char *)element + hashtable_element_size(hk->key_len));
+        *value         = *counter;
+        element->e     = value;
+    }
+
+    hashtable_element_version(shard, element);
+
+    /* Evict elements if the capacity or the memory of the shard is reached, then add element to the shard */
+    if ((0 != hashtable_make_room(hashtable, shard, hashtable_element_bytes(element), NULL)) || (0 != hashtable_insert(hashtable, shard, element, hash))) {
+        /* Unable to insert the element, the element given still belongs to the caller if it has not been copied */
+        if ((true == hashtable->config.alloc) && (NULL != element->e) && (e != element->e)) {
+            hashtable_value_put(hashtable, element->e);
+        }
+        hashtable_element_free(element);
+        return NULL;
+    }
+    __atomic_store_n(&shard->count, shard->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->bytes, shard->bytes + hashtable_element_bytes(element), __ATOMIC_RELAXED);
+
+    /* Check if the shard should be resized */
+    hashtable_check_load(hashtable, shard);
+
+    return element;
+}
+
+/**
+ * @brief Lookup element of the hashtable, add it if it is not found, used by hashtable_lookup_or_add, hashtable_lookup_or_create and hashtable_get_or_load
+ * @param hashtable Hashtable instance
+ * @param hk Pre-hashed key of the element
+ * @param e Element to be added in the hashtable, used if fct is NULL
+ * @param size Size of the element to be added, used if fct is NULL
+ * @param owned true if the element given or created belongs to the hashtable, it is then released once copied in alloc mode or if it is not added
+ * @param fct Function creating the element to be added, may be NULL
+ * @param user User data given to the function
+ * @param admit true to submit the element to the admission of the shard, the element is then returned without being stored if it is rejected, only
+ * possible if values are reference counted
+ * @return Element of the hashtable, NULL if it can not be added
+ */
+static void *
+hashtable_lookup_or_add_element(hashtable_t *hashtable, hashtable_key_t *hk, void *e, size_t size, bool owned, hashtable_create_fct_t fct, void *user,
+                                bool admit) {
+
+    assert(NULL != hashtable);
+    assert(NULL != hk);
+    assert((false == admit) || (true == hashtable->config.refcount));
+
+    /* Retrieve hash value of the wanted key and the shard */
+    uint64_t           hash  = hashtable_key_hash(hashtable, hk);
+    hashtable_shard_t *shard = hashtable_get_shard(hashtable, hash);
+
+    /* Lock shard for writing, the element can not be added by another thread between the lookup and the insertion */
+    hashtable_lock_write(hashtable, shard);
+
+    /* Migrate some elements if a rehash is in progress, and remove the elements which have expired */
+    hashtable_rehash(hashtable, shard, HASHTABLE_REHASH_STEP);
+    hashtable_expire_shard(hashtable, shard);
+
+    /* Lookup for the wanted element, create a new hashtable element if it is not found */
+    hashtable_element_t *curr     = hashtable_search(hashtable, shard, hk->key, hk->key_len, hash);
+    hashtable_element_t *added    = NULL;
+    void *               rejected = NULL;
+    if (NULL == curr) {
+        if (NULL != fct) {
+            size = 0;
+            e    = fct(hk->key, hk->key_len, &size, user);
+        }
+        if ((NULL == fct) || (NULL != e)) {
+            int ret = (true == admit) ? hashtable_admit(hashtable, shard, hash, hashtable_element_size(hk->key_len) + size) : 0;
+            if (0 == ret) {
+                curr = added = hashtable_add_element(hashtable, shard, hk, hash, e, size, NULL);
+            } else if (1 == ret) {
+                /* The element is not stored, the caller gets the only reference to a copy of it */
+                rejected = hashtable_value_copy(hashtable, e, size);
+            }
+        }
+    }
+
+    /* The element owned by the hashtable is released once copied in alloc mode, or if it is not added because the key is found or on failure */
+    if ((true == owned) && (NULL != e)) {
+        if (NULL == added) {
+            hashtable_reject(hashtable, hk->key, hk->key_len, e);
+        }
+        if ((true == hashtable->config.alloc) && ((NULL == added) || (e != added->e))) {
+            free(e);
+        }
+    }
+    e = (NULL != curr) ? hashtable_value_get(hashtable, curr) : rejected;
+
+    /* Unlock shard */
+    hashtable_unlock(hashtable, shard);
+
+    return e;
+}
+
+/**
+ * @brief Resize the shard at once so that the wanted number of elements can be stored without resizing it again
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param count Number of elements
+ */
+static void
+hashtable_reserve(hashtable_t *hashtable, hashtable_shard_t *shard, size_t count) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* Nothing to do if the hashtable is not grown */
+    if (false == hashtable->config.grow) {
+        return;
+    }
+
+    /* Complete the rehash in progress, then migrate all elements to a table large enough */
+    while (NULL != shard->table[1]) {
+        hashtable_rehash(hashtable, shard, shard->table[0]->size);
+    }
+    size_t size = shard->table[0]->size;
+    while (count > size * HASHTABLE_GROW_LOAD_FACTOR) {
+        size *= 2;
+    }
+    if (size > shard->table[0]->size) {
+        hashtable_resize(shard, size);
+        while (NULL != shard->table[1]) {
+            hashtable_rehash(hashtable, shard, shard->table[0]->size);
+        }
+    }
+}
+
+/**
+ * @brief Lookup for the element with the wanted key in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element of the shard, NULL if not found
+ */
+static hashtable_element_t *
+hashtable_search(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != key);
+
+    /* Lookup for the wanted element in the tables, loads are paired with the stores of the writers */
+    for (int index = 0; index < 2; index++) {
+        hashtable_table_t *table = __atomic_load_n(&shard->table[index], __ATOMIC_ACQUIRE);
+        if (NULL == table) {
+            break;
+        }
+        hashtable_element_t *curr = __atomic_load_n(&table->lists[hash & (table->size - 1)], __ATOMIC_ACQUIRE);
+        while (NULL != curr) {
+            if ((curr->hash == hash) && (curr->key_len == key_len) && (0 == memcmp(curr->key, key, key_len))) {
+                /* Element found, the hash value and the length are compared first */
+                return curr;
+            }
+            curr = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Insert new element in the shard
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param element Element to be inserted
+ * @param hash Hash value of the key of the element
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int
+hashtable_insert(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element, uint64_t hash) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* Add element in the new table if a rehash is in progress, the element is published once initialized */
+    hashtable_table_t *table = shard->table[(NULL != shard->table[1]) ? 1 : 0];
+    element->next            = table->lists[hash & (table->size - 1)];
+    __atomic_store_n(&table->lists[hash & (table->size - 1)], element, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Unlink the element with the wanted key from the shard, the element is not released and entries of the shard become invalid
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element unlinked from the shard, NULL if not found
+ */
+static hashtable_element_t *
+hashtable_unlink(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != key);
+
+    /* Lookup for the wanted element in the tables */
+    for (int index = 0; (index < 2) && (NULL != shard->table[index]); index++) {
+        hashtable_element_t **link = &shard->table[index]->lists[hash & (shard->table[index]->size - 1)];
+        while (NULL != *link) {
+            hashtable_element_t *curr = *link;
+            if ((curr->hash == hash) && (curr->key_len == key_len) && (0 == memcmp(curr->key, key, key_len))) {
+                /* Update the list of elements, readers may still be parsing the element which keeps its next element */
+                hashtable_history_record(hashtable, shard, curr);
+                __atomic_store_n(link, curr->next, __ATOMIC_RELEASE);
+                __atomic_store_n(&shard->generation, shard->generation + 1, __ATOMIC_RELEASE);
+                __atomic_add_fetch(&shard->version, 1, __ATOMIC_RELAXED);
+                hashtable_timer_remove(shard->wheel, curr);
+                return curr;
+            }
+            link = &curr->next;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Evict elements of the shard until an element can be added or grown without exceeding its capacity and its memory
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param bytes Number of bytes to be added to the shard
+ * @param keep Element of the shard which is grown and must not be evicted, NULL if a new element is added
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int
+hashtable_make_room(hashtable_t *hashtable, hashtable_shard_t *shard, size_t bytes, hashtable_element_t *keep) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* The capacity is only checked when a new element is added, the element grown is never evicted */
+    size_t min = (NULL != keep) ? 1 : 0;
+    while ((shard->count > min)
+           && (((NULL == keep) && (0 != shard->capacity) && (shard->count >= shard->capacity))
+               || ((0 != shard->memory) && (shard->bytes + bytes > shard->memory)))) {
+        if ((0 != hashtable_retire_reserve(hashtable, shard, 2))
+            || (0 != hashtable_discard(hashtable, shard, hashtable_victim(hashtable, shard, keep, false)))) {
+            /* Unable to allocate memory */
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Select the element of the shard to be evicted, elements accessed since the clock hand passed them are given a second chance
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing, which is not empty
+ * @param keep Element of the shard which must not be selected, may be NULL
+ * @param peek true to only get the element which would be selected, without moving the clock hand nor clearing the flags of the elements
+ * @return Element to be evicted
+ */
+static hashtable_element_t *
+hashtable_victim(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *keep, bool peek) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(((NULL == keep) && (0 < shard->count)) || (1 < shard->count));
+
+    /* The clock hand goes through the lists of both tables if a rehash is in progress */
+    size_t size0 = shard->table[0]->size;
+    size_t size1 = (NULL != shard->table[1]) ? shard->table[1]->size : 0;
+
+    /* Move the clock hand until an element which has not been accessed is found, all flags are cleared after one turn */
+    hashtable_element_t *victim = NULL;
+    hashtable_element_t *first  = NULL;
+    size_t               hand   = shard->hand;
+    for (size_t step = 0; NULL == victim; step++) {
+        /* Lock-free readers may set the flags again, the first element found is evicted after two turns */
+        bool   force    = (step >= 2 * (size0 + size1));
+        size_t position = hand % (size0 + size1);
+        hashtable_element_t *curr = (position < size0) ? shard->table[0]->lists[position] : shard->table[1]->lists[position - size0];
+        while ((NULL != curr) && (NULL == victim)) {
+            first = ((NULL == first) && (curr != keep)) ? curr : first;
+            if ((false == force) && (true == __atomic_load_n(&curr->referenced, __ATOMIC_RELAXED))) {
+                if (false == peek) {
+                    __atomic_store_n(&curr->referenced, false, __ATOMIC_RELAXED);
+                }
+            } else if (curr != keep) {
+                victim = curr;
+            }
+            curr = curr->next;
+        }
+        hand = position + 1;
+
+        /* Without clearing the flags, the first element found would be selected once the clock hand has cleared them all */
+        if ((true == peek) && (NULL == victim) && (step + 1 == size0 + size1)) {
+            victim = first;
+        }
+    }
+    if (false == peek) {
+        shard->hand = hand;
+    }
+
+    return victim;
+}
+
+/**
+ * @brief Check if a new element is admitted in the shard, the element is compared with the element it would evict, which is evicted if it is admitted
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param hash Hash value of the key of the new element
+ * @param bytes Number of bytes used by the new element
+ * @return 0 if the element can be added, 1 if its key is estimated to be accessed less often than the key of the element it would evict, -1 otherwise
+ */
+static int
+hashtable_admit(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t hash, size_t bytes) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* All elements are admitted if the shard has no frequency sketch, adding the element is an access to its key */
+    if (NULL == shard->sketch) {
+        return 0;
+    }
+    hashtable_sketch_record(shard->sketch, hash);
+
+    /* The element is admitted if no element has to be evicted */
+    bool full = ((0 != shard->capacity) && (shard->count >= shard->capacity))
+                || ((0 != shard->memory) && (shard->bytes + bytes > shard->memory));
+    if ((false == full) || (0 == shard->count)) {
+        return 0;
+    }
+
+    /* Compare the frequency of the key with the one of the first element to be evicted, ties keep the element already stored, rejected elements do not
+     * move the clock hand nor clear the flags of the other elements */
+    hashtable_element_t *victim = hashtable_victim(hashtable, shard, NULL, true);
+    if (hashtable_sketch_estimate(shard->sketch, hash) <= hashtable_sketch_estimate(shard->sketch, victim->hash)) {
+        return 1;
+    }
+
+    /* Evict the element, other elements are evicted when the new element is added if it is still needed */
+    if ((0 != hashtable_retire_reserve(hashtable, shard, 2)) || (0 != hashtable_discard(hashtable, shard, hashtable_victim(hashtable, shard, NULL, false)))) {
+        /* Unable to allocate memory */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Discard a new element which has not been admitted, as if it had been added and evicted right away
+ * @param hashtable Hashtable instance
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element which has not been added, given to the evict function in reference mode
+ */
+static void
+hashtable_reject(hashtable_t *hashtable, const void *key, size_t key_len, void *e) {
+
+    assert(NULL != hashtable);
+    assert(NULL != key);
+
+    /* The element is only copied in alloc mode, it belongs to the hashtable in reference mode */
+    if ((false == hashtable->config.alloc) && (NULL != hashtable->config.evict_fct)) {
+        hashtable->config.evict_fct((const char *)key, key_len, e, hashtable->config.evict_user);
+    }
+}
+
+/**
+ * @brief Create a frequency sketch
+ * @param size Number of counters of each row, power of two
+ * @return Frequency sketch if the function succeeded, NULL otherwise
+ */
+static hashtable_sketch_t *
+hashtable_sketch_create(size_t size) {
+
+    /* Create sketch, counters of the rows are allocated with the sketch */
+    hashtable_sketch_t *sketch = (hashtable_sketch_t *)malloc(sizeof(hashtable_sketch_t) + HASHTABLE_SKETCH_ROWS * size);
+    if (NULL == sketch) {
+        /* Unable to allocate memory */
+        return NULL;
+    }
+    sketch->size     = size;
+    sketch->count    = 0;
+    sketch->counters = (uint8_t *)(sketch + 1);
+    memset(sketch->counters, 0, HASHTABLE_SKETCH_ROWS * size);
+
+    return sketch;
+}
+
+/**
+ * @brief Record an access to a key in the frequency sketch, counters are halved periodically
+ * @param sketch Frequency sketch of the shard, which may be accessed concurrently by readers
+ * @param hash Hash value of the key
+ */
+static void
+hashtable_sketch_record(hashtable_sketch_t *sketch, uint64_t hash) {
+
+    assert(NULL != sketch);
+
+    /* Only the smallest counters of the key are incremented, concurrent increments may be lost which only lowers the estimation */
+    uint8_t  min  = hashtable_sketch_estimate(sketch, hash);
+    uint64_t mix  = hashtable_mix(hash);
+    uint64_t step = (mix >> 32) | 1;
+    if (HASHTABLE_SKETCH_MAX > min) {
+        for (size_t row = 0; row < HASHTABLE_SKETCH_ROWS; row++) {
+            uint8_t *counter = &sketch->counters[row * sketch->size + ((mix + row * step) & (sketch->size - 1))];
+            if (min == __atomic_load_n(counter, __ATOMIC_RELAXED)) {
+                __atomic_store_n(counter, min + 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    /* Halve all counters once enough accesses have been recorded, a single thread reaches the threshold */
+    if (HASHTABLE_SKETCH_AGING * sketch->size == __atomic_add_fetch(&sketch->count, 1, __ATOMIC_RELAXED)) {
+        for (size_t index = 0; index < HASHTABLE_SKETCH_ROWS * sketch->size; index++) {
+            __atomic_store_n(&sketch->counters[index], __atomic_load_n(&sketch->counters[index], __ATOMIC_RELAXED) >> 1, __ATOMIC_RELAXED);
+        }
+        __atomic_sub_fetch(&sketch->count, HASHTABLE_SKETCH_AGING * sketch->size / 2, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Estimate the number of accesses to a key recorded in the frequency sketch
+ * @param sketch Frequency sketch of the shard
+ * @param hash Hash value of the key
+ * @return Minimum of the counters of the key in each row
+ */
+static uint8_t
+hashtable_sketch_estimate(hashtable_sketch_t *sketch, uint64_t hash) {
+
+    assert(NULL != sketch);
+
+    /* Counters of the key are selected in each row by double hashing of the mixed hash value */
+    uint8_t  min  = HASHTABLE_SKETCH_MAX;
+    uint64_t mix  = hashtable_mix(hash);
+    uint64_t step = (mix >> 32) | 1;
+    for (size_t row = 0; row < HASHTABLE_SKETCH_ROWS; row++) {
+        uint8_t value = __atomic_load_n(&sketch->counters[row * sketch->size + ((mix + row * step) & (sketch->size - 1))], __ATOMIC_RELAXED);
+        if (value < min) {
+            min = value;
+        }
+    }
+
+    return min;
+}
+
+/**
+ * @brief Unlink the element from the shard and discard it, the element is given to the evict function or released
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param element Element of the shard
+ * @return 0 if the function succeeded, -1 if memory can not be allocated while snapshots exist
+ */
+static int
+hashtable_discard(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* The value given to the evict function is copied first if snapshots exist */
+    void *copy = NULL;
+    if ((NULL != hashtable->config.evict_fct) && (0 != hashtable_value_detach_copy(hashtable, shard, element, &copy))) {
+        /* Unable to allocate memory */
+        return -1;
+    }
+
+    /* Unlink the element and give it to the evict function, or release the value owned by the hashtable */
+    hashtable_unlink(hashtable, shard, element->key, element->key_len, element->hash);
+    __atomic_store_n(&shard->count, shard->count - 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->bytes, shard->bytes - hashtable_element_bytes(element), __ATOMIC_RELAXED);
+    void *   e       = hashtable_element_value(element);
+    uint64_t version = __atomic_load_n(&element->version, __ATOMIC_RELAXED);
+    if (NULL != hashtable->config.evict_fct) {
+        hashtable->config.evict_fct(element->key, element->key_len, hashtable_value_detach(hashtable, shard, e, version, copy), hashtable->config.evict_user);
+    } else if ((true == hashtable->config.alloc) && (NULL != e)) {
+        hashtable_retire(hashtable, shard, e, HASHTABLE_RETIRED_VALUE, version);
+    }
+    hashtable_retire(hashtable, shard, element, HASHTABLE_RETIRED_ELEMENT, 0);
+
+    return 0;
+}
+
+/**
+ * @brief Get the current time of the monotonic clock
+ * @return Current time in milliseconds
+ */
+static uint64_t
+hashtable_clock(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Add the element to the slot of the timer wheel matching the time remaining before its expiration
+ * @param wheel Timer wheel of the shard
+ * @param element Element of the shard, which is not in the timer wheel
+ */
+static void
+hashtable_timer_add(hashtable_wheel_t *wheel, hashtable_element_t *element) {
+
+    assert(NULL != wheel);
+    assert(NULL != element);
+    assert(NULL == element->timer_prev);
+
+    /* Elements which have already expired are stored in the current slot, elements expiring after the last level in its last slot */
+    uint64_t mask  = ((uint64_t)1 << HASHTABLE_WHEEL_BITS) - 1;
+    uint64_t tick  = (element->expire > wheel->now) ? element->expire : wheel->now;
+    uint64_t delta = tick - wheel->now;
+    if (delta >= ((uint64_t)1 << (HASHTABLE_WHEEL_BITS * HASHTABLE_WHEEL_LEVELS))) {
+        tick = wheel->now + ((uint64_t)1 << (HASHTABLE_WHEEL_BITS * HASHTABLE_WHEEL_LEVELS)) - 1;
+    }
+
+    /* Select the first level whose slots cover the time remaining, the element is moved to the lower level when its slot is reached */
+    int level = 0;
+    while ((level < HASHTABLE_WHEEL_LEVELS - 1) && (delta >= ((uint64_t)1 << (HASHTABLE_WHEEL_BITS * (level + 1))))) {
+        level++;
+    }
+    size_t slot = (size_t)((tick >> (HASHTABLE_WHEEL_BITS * level)) & mask);
+
+    /* Add element at the head of the slot */
+    element->timer_next = wheel->slots[level][slot];
+    if (NULL != element->timer_next) {
+        element->timer_next->timer_prev = &element->timer_next;
+    }
+    wheel->slots[level][slot] = element;
+    element->timer_prev       = &wheel->slots[level][slot];
+    wheel->bitmap[level] |= (uint64_t)1 << slot;
+}
+
+/**
+ * @brief Remove the element from the timer wheel if it is in the timer wheel
+ * @param wheel Timer wheel of the shard
+ * @param element Element of the shard
+ */
+static void
+hashtable_timer_remove(hashtable_wheel_t *wheel, hashtable_element_t *element) {
+
+    assert(NULL != element);
+
+    /* Nothing to do if the element is not in the timer wheel */
+    if (NULL == element->timer_prev) {
+        return;
+    }
+    assert(NULL != wheel);
+
+    /* Unlink the element */
+    *element->timer_prev = element->timer_next;
+    if (NULL != element->timer_next) {
+        element->timer_next->timer_prev = element->timer_prev;
+    }
+
+    /* Clear the bit of the slot if the element was its last one, the link is then the head of the slot */
+    uintptr_t link  = (uintptr_t)element->timer_prev;
+    uintptr_t first = (uintptr_t)&wheel->slots[0][0];
+    if ((link >= first) && (link < first + sizeof(wheel->slots)) && (NULL == *element->timer_prev)) {
+        size_t index = (link - first) / sizeof(hashtable_element_t *);
+        wheel->bitmap[index >> HASHTABLE_WHEEL_BITS] &= ~((uint64_t)1 << (index & (((size_t)1 << HASHTABLE_WHEEL_BITS) - 1)));
+    }
+    element->timer_next = NULL;
+    element->timer_prev = NULL;
+}
+
+/**
+ * @brief Remove the elements of the shard which have expired, the timer wheel is advanced up to the current time
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @return Number of elements removed
+ */
+static size_t
+hashtable_expire_shard(hashtable_t *hashtable, hashtable_shard_t *shard) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    size_t             count = 0;
+    hashtable_wheel_t *wheel = shard->wheel;
+    uint64_t           mask  = ((uint64_t)1 << HASHTABLE_WHEEL_BITS) - 1;
+
+    /* Nothing to do if no element of the shard expires */
+    if (NULL == wheel) {
+        return 0;
+    }
+
+    /* Advance the timer wheel up to the current time */
+    uint64_t target = hashtable_clock();
+    while (wheel->now < target) {
+
+        /* Skip the empty slots of all levels, the next tick is the first one reaching a slot which is not empty, a slot of each level being reached
+         * once per turn of this level */
+        uint64_t tick = UINT64_MAX;
+        for (int level = 0; level < HASHTABLE_WHEEL_LEVELS; level++) {
+            if (0 != wheel->bitmap[level]) {
+                uint64_t base    = (wheel->now >> (HASHTABLE_WHEEL_BITS * level)) + 1;
+                size_t   index   = (size_t)(base & mask);
+                uint64_t bitmap  = wheel->bitmap[level];
+                uint64_t pending = (0 == index) ? bitmap : ((bitmap >> index) | (bitmap << (((size_t)1 << HASHTABLE_WHEEL_BITS) - index)));
+                uint64_t next    = (base + (uint64_t)__builtin_ctzll(pending)) << (HASHTABLE_WHEEL_BITS * level);
+                tick             = (next < tick) ? next : tick;
+            }
+        }
+        if (tick > target) {
+            /* Nothing to do until the current time, including when the timer wheel is empty */
+            wheel->now = target;
+            break;
+        }
+        wheel->now = tick;
+
+        /* Move the elements of the slots of the upper levels starting at this tick to the lower levels, highest level first */
+        int level = 1;
+        while ((level < HASHTABLE_WHEEL_LEVELS) && (0 == (tick & (((uint64_t)1 << (HASHTABLE_WHEEL_BITS * level)) - 1)))) {
+            level++;
+        }
+        while (1 < level--) {
+            size_t               slot = (size_t)((tick >> (HASHTABLE_WHEEL_BITS * level)) & mask);
+            hashtable_element_t *curr = wheel->slots[level][slot];
+            wheel->slots[level][slot] = NULL;
+            wheel->bitmap[level] &= ~((uint64_t)1 << slot);
+            while (NULL != curr) {
+                hashtable_element_t *next = curr->timer_next;
+                curr->timer_next          = NULL;
+                curr->timer_prev          = NULL;
+                hashtable_timer_add(wheel, curr);
+                curr = next;
+            }
+        }
+
+        /* Discard the elements of the slot of the first level which have expired */
+        size_t               slot = (size_t)(tick & mask);
+        hashtable_element_t *curr = wheel->slots[0][slot];
+        wheel->slots[0][slot]     = NULL;
+        wheel->bitmap[0] &= ~((uint64_t)1 << slot);
+        while (NULL != curr) {
+            hashtable_element_t *next = curr->timer_next;
+            curr->timer_next          = NULL;
+            curr->timer_prev          = NULL;
+            if ((curr->expire <= tick) && (0 == hashtable_retire_reserve(hashtable, shard, 2)) && (0 == hashtable_discard(hashtable, shard, curr))) {
+                count++;
+            } else {
+                /* Elements not expired yet, or which can not be discarded until memory is available, are added to the wheel again */
+                hashtable_timer_add(wheel, curr);
+            }
+            curr = next;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Call the wanted function for each element of the shard, the function may release the element
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param fct Function called for each element
+ * @param user User data given to the function
+ */
+static void
+hashtable_foreach(hashtable_t *hashtable, hashtable_shard_t *shard, void (*fct)(hashtable_element_t *, void *), void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != fct);
+
+    /* Parse the tables */
+    for (int index = 0; (index < 2) && (NULL != shard->table[index]); index++) {
+        for (size_t hash = 0; hash < shard->table[index]->size; hash++) {
+            hashtable_element_t *curr = shard->table[index]->lists[hash];
+            while (NULL != curr) {
+                hashtable_element_t *next = curr->next;
+                fct(curr, user);
+                curr = next;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Store the key of the element at the position pointed by the cursor, used by hashtable_get_keys
+ * @param element Element of the hashtable
+ * @param user Cursor in the table of keys
+ */
+static void
+hashtable_get_keys_cb(hashtable_element_t *element, void *user) {
+
+    assert(NULL != element);
+    assert(NULL != user);
+
+    /* Store key and move the cursor */
+    char ***cursor = (char ***)user;
+    **cursor       = element->key;
+    (*cursor)++;
+}
+
+/**
+ * @brief Store the element in the snapshot if it has not been modified since the cut, used by hashtable_snapshot_shard
+ * @param element Element of the hashtable
+ * @param user Snapshot cursor
+ */
+static void
+hashtable_snapshot_cb(hashtable_element_t *element, void *user) {
+
+    assert(NULL != element);
+    assert(NULL != user);
+
+    /* Elements modified since the cut are stored from their history records */
+    hashtable_snapshot_cursor_t *cursor = (hashtable_snapshot_cursor_t *)user;
+    if (__atomic_load_n(&element->version, __ATOMIC_RELAXED) <= cursor->version) {
+        int64_t *counter = hashtable_element_counter(element);
+        hashtable_snapshot_store(cursor, element->key, element->key_len, (NULL != counter) ? (void *)counter : element->e, (NULL != counter));
+    }
+}
+
+/**
+ * @brief Count the element or store it at the position pointed by the cursor, the key and the counter are copied
+ * @param cursor Snapshot cursor
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element itself, or its counter
+ * @param counter Flag set if the element is a counter
+ */
+static void
+hashtable_snapshot_store(hashtable_snapshot_cursor_t *cursor, const char *key, size_t key_len, void *e, bool counter) {
+
+    assert(NULL != cursor);
+    assert(NULL != key);
+
+    /* Count the element while the memory of the shard is not allocated */
+    if (NULL == cursor->key) {
+        cursor->count++;
+        cursor->counters += (true == counter) ? 1 : 0;
+        cursor->bytes += key_len + 1;
+        return;
+    }
+
+    /* Copy the key and the counter, values are referenced if they are reference counted */
+    hashtable_snapshot_t *     snapshot = cursor->snapshot;
+    hashtable_snapshot_item_t *item     = &snapshot->items[snapshot->count++];
+    memcpy(cursor->key, key, key_len);
+    cursor->key[key_len] = '\0';
+    item->key            = cursor->key;
+    item->key_len        = key_len;
+    cursor->key += key_len + 1;
+    if (true == counter) {
+        *cursor->counter = __atomic_load_n((int64_t *)e, __ATOMIC_RELAXED);
+        item->e          = cursor->counter++;
+    } else {
+        item->e = e;
+        if ((true == snapshot->hashtable->config.refcount) && (NULL != e)) {
+            __atomic_add_fetch(&((hashtable_value_t *)e - 1)->refs, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Store the elements of the shard in the snapshot as they were at the cut, the shard is not pending for the snapshot anymore
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param snapshot Snapshot of the hashtable
+ * @param index Index of the shard
+ * @return 0 if the function succeeded, -1 if memory can not be allocated
+ */
+static int
+hashtable_snapshot_shard(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_snapshot_t *snapshot, size_t index) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != snapshot);
+
+    /* Count the elements of the cut, from the shard and from the history records */
+    hashtable_snapshot_cursor_t cursor = { snapshot, snapshot->cuts[index].version, 0, 0, 0, NULL, NULL };
+    for (int pass = 0; pass < 2; pass++) {
+        hashtable_foreach(hashtable, shard, hashtable_snapshot_cb, &cursor);
+        for (hashtable_history_t *record = shard->history; NULL != record; record = record->next) {
+            if ((record->version <= cursor.version) && (cursor.version < record->replaced)) {
+                hashtable_snapshot_store(&cursor, record->element->key, record->element->key_len, record->e, (record->e == &record->counter));
+            }
+        }
+
+        /* Allocate the copies of the counters and the keys, then store the elements */
+        if ((0 == pass) && (0 != cursor.count)) {
+            hashtable_snapshot_item_t *items
+                = (hashtable_snapshot_item_t *)realloc(snapshot->items, (snapshot->count + cursor.count) * sizeof(hashtable_snapshot_item_t));
+            if (NULL == items) {
+                /* Unable to allocate memory */
+                return -1;
+            }
+            snapshot->items = items;
+            if (NULL == (snapshot->keys[index] = (char *)malloc(cursor.counters * sizeof(int64_t) + cursor.bytes))) {
+                /* Unable to allocate memory */
+                return -1;
+            }
+            cursor.counter = (int64_t *)snapshot->keys[index];
+            cursor.key     = snapshot->keys[index] + cursor.counters * sizeof(int64_t);
+        } else if (0 == pass) {
+            break;
+        }
+    }
+
+    /* History records are not needed by the snapshot anymore */
+    hashtable_snapshot_done(hashtable, shard, &snapshot->cuts[index]);
+
+    return 0;
+}
+
+/**
+ * @brief Mark the shard as not pending for the snapshot anymore, history records are released once no snapshot of the shard is pending
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param cut Cut of the snapshot
+ */
+static void
+hashtable_snapshot_done(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_cut_t *cut) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != cut);
+
+    /* Release the history records, readers can not access them */
+    cut->pending = false;
+    __atomic_store_n(&shard->pending, shard->pending - 1, __ATOMIC_SEQ_CST);
+    while ((0 == shard->pending) && (NULL != shard->history)) {
+        hashtable_history_t *tmp = shard->history;
+        shard->history           = shard->history->next;
+        if ((true == hashtable->config.refcount) && (NULL != tmp->e)) {
+            hashtable_value_put(hashtable, tmp->e);
+        }
+        free(tmp);
+    }
+
+    /* Release the elements and values which were only kept for the snapshot */
+    hashtable_unpin(hashtable, shard);
+}
+
+/**
+ * @brief Check if a snapshot of the shard includes a state of an element, or may include it because its cut is not known yet
+ * @param shard Shard of the hashtable locked for writing
+ * @param version Version of the element
+ * @param replaced Version of the shard once the element has been modified or removed, UINT64_MAX if it is still in the shard
+ * @return true if a snapshot may include the state of the element, false otherwise
+ */
+static bool
+hashtable_snapshot_covers(hashtable_shard_t *shard, uint64_t version, uint64_t replaced) {
+
+    assert(NULL != shard);
+
+    /* Parse the cuts of the shard */
+    for (hashtable_cut_t *cut = shard->cuts; NULL != cut; cut = cut->next) {
+        if ((UINT64_MAX == cut->version) || ((version <= cut->version) && (cut->version < replaced))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Record the state of an element before it is modified or removed while snapshots of the shard are pending
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing, history record allocated in advance by hashtable_retire_reserve
+ * @param element Element of the shard
+ */
+static void
+hashtable_history_record(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_element_t *element) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != element);
+
+    /* Nothing to do if no snapshot of the shard is pending, or if the state of the element is already recorded */
+    if ((0 == shard->pending)
+        || ((NULL != shard->history) && (element == shard->history->element)
+            && (shard->history->version == __atomic_load_n(&element->version, __ATOMIC_RELAXED)))) {
+        return;
+    }
+
+    /* Record the element, its counter or a reference to its value, the version of the shard is incremented by the modification */
+    hashtable_history_t *record = shard->history_spare;
+    assert(NULL != record);
+    shard->history_spare = NULL;
+    int64_t *counter     = hashtable_element_counter(element);
+    record->element      = element;
+    if (NULL != counter) {
+        record->counter = __atomic_load_n(counter, __ATOMIC_RELAXED);
+        record->e       = &record->counter;
+    } else {
+        record->e = hashtable_value_get(hashtable, element);
+    }
+    record->version  = __atomic_load_n(&element->version, __ATOMIC_RELAXED);
+    record->replaced = __atomic_load_n(&shard->version, __ATOMIC_RELAXED) + 1;
+    record->next     = shard->history;
+    shard->history   = record;
+}
+
+/**
+ * @brief Release the element, used by hashtable_release
+ * @param element Element of the hashtable
+ * @param user Hashtable instance
+ */
+static void
+hashtable_release_cb(hashtable_element_t *element, void *user) {
+
+    assert(NULL != element);
+    assert(NULL != user);
+
+    /* Release memory */
+    hashtable_t *hashtable = (hashtable_t *)user;
+    void *       e         = hashtable_element_value(element);
+    if ((true == hashtable->config.alloc) && (NULL != e)) {
+        hashtable_value_put(hashtable, e);
+    }
+    hashtable_element_free(element);
+}
+
+/**
+ * @brief Reverse the bits of the value
+ * @param v Value
+ * @return Value with reversed bits
+ */
+static uint64_t
+hashtable_scan_reverse(uint64_t v) {
+
+    /* Swap bits, then pairs, nibbles, bytes, 16-bit and 32-bit words */
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    v = (v >> 32) | (v << 32);
+
+    return v;
+}
+
+/**
+ * @brief Increment the reversed bits of the cursor covered by the mask, used by hashtable_scan
+ * @param v Cursor
+ * @param mask Mask of the buckets of the table, size of the table minus one
+ * @return Next cursor, 0 if all buckets covered by the mask have been visited
+ */
+static uint64_t
+hashtable_scan_next(uint64_t v, uint64_t mask) {
+
+    /* Set the bits not covered by the mask so that the carry goes through them, the highest bit of the bucket being incremented first */
+    v |= ~mask;
+    v = hashtable_scan_reverse(v);
+    v++;
+    v = hashtable_scan_reverse(v);
+
+    return v;
+}
+
+/**
+ * @brief Visit the buckets of the shard pointed by the cursor, used by hashtable_scan
+ * When a rehash is in progress, the bucket of the smallest table and all the buckets of the largest table it expands to are visited.
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param v Cursor in the shard
+ * @param fct Function called for each element of the visited buckets
+ * @param user User data given to the function
+ * @return Next cursor in the shard, 0 if all buckets of the shard have been visited
+ */
+static uint64_t
+hashtable_scan_shard(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t v, hashtable_scan_fct_t fct, void *user) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != fct);
+
+    /* Parse the bucket of the smallest table */
+    hashtable_table_t *small = shard->table[0];
+    hashtable_table_t *large = shard->table[1];
+    if ((NULL != large) && (large->size < small->size)) {
+        small = shard->table[1];
+        large = shard->table[0];
+    }
+    uint64_t small_mask = small->size - 1;
+    for (hashtable_element_t *curr = small->lists[v & small_mask]; NULL != curr; curr = curr->next) {
+        fct(curr->key, curr->key_len, curr->e, user);
+    }
+    if (NULL == large) {
+        return hashtable_scan_next(v, small_mask);
+    }
+
+    /* Parse the buckets of the largest table the bucket of the smallest table expands to */
+    uint64_t large_mask = large->size - 1;
+    do {
+        for (hashtable_element_t *curr = large->lists[v & large_mask]; NULL != curr; curr = curr->next) {
+            fct(curr->key, curr->key_len, curr->e, user);
+        }
+        v = hashtable_scan_next(v, large_mask);
+    } while (0 != (v & (small_mask ^ large_mask)));
+
+    return v;
+}
+
+/**
+ * @brief Mix hash value so that all its bits depend on all the bits of the input value
+ * @param hash Hash value
+ * @return Mixed hash value
+ */
+static uint64_t
+hashtable_mix(uint64_t hash) {
+
+    /* 64 bits finalizer of MurmurHash3 */
+    uint64_t mix = hash;
+    mix ^= mix >> 33;
+    mix *= 0xFF51AFD7ED558CCDULL;
+    mix ^= mix >> 33;
+    mix *= 0xC4CEB9FE1A85EC53ULL;
+    mix ^= mix >> 33;
+
+    return mix;
+}
+
+/**
+ * @brief Lookup for the element with the wanted key in the shard locked for reading
+ * In HASHTABLE_LOCK_RCU mode, the lookup is done again if elements have been migrated in the meantime. Even without lock, the lookup writes to shared
+ * memory when the shard is bounded: the access is recorded in the frequency sketch and the referenced flag of the element is set if it was cleared.
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param hash Hash value of the key
+ * @return Element of the shard, NULL if not found
+ */
+static hashtable_element_t *
+hashtable_find_read(hashtable_t *hashtable, hashtable_shard_t *shard, const void *key, size_t key_len, uint64_t hash) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != key);
+
+    /* Direct lookup if the shard is locked, lookup until no migration occurred in the meantime otherwise, the element may have been missed */
+    hashtable_element_t *curr;
+    if (HASHTABLE_LOCK_RCU != hashtable->config.lock) {
+        curr = hashtable_search(hashtable, shard, key, key_len, hash);
+    } else {
+        unsigned int seq;
+        do {
+            while (0 != ((seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE)) & 1)) {
+                /* Migration in progress */
+                sched_yield();
+            }
+            curr = hashtable_search(hashtable, shard, key, key_len, hash);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while (seq != __atomic_load_n(&shard->seq, __ATOMIC_RELAXED));
+    }
+
+    /* Record the access to the key, found or not, in the frequency sketch */
+    if (NULL != shard->sketch) {
+        hashtable_sketch_record(shard->sketch, hash);
+    }
+
+    /* Elements which have expired are not found anymore, even if they have not been removed yet */
+    if (NULL != curr) {
+        uint64_t expire = __atomic_load_n(&curr->expire, __ATOMIC_RELAXED);
+        if ((0 != expire) && (expire <= hashtable_clock())) {
+            return NULL;
+        }
+    }
+
+    /* Mark the element as accessed, the flag is only written if it is not already set so that hot elements do not bounce between caches */
+    bool evict = (0 != shard->capacity) || (0 != shard->memory);
+    if ((true == evict) && (NULL != curr) && (false == __atomic_load_n(&curr->referenced, __ATOMIC_RELAXED))) {
+        __atomic_store_n(&curr->referenced, true, __ATOMIC_RELAXED);
+    }
+
+    return curr;
+}
+
+/**
+ * @brief Prefetch the memory which will be accessed by the lookup of the wanted hash value in the shard
  * @param hashtable Hashtable instance
- * @param key Key as string
- * @return Hash value modulo hashtable size to be used in the hashtable table
+ * @param shard Shard of the hashtable locked for reading
+ * @param hash Hash value of the key
+ * @param element false to prefetch the list of elements, true to prefetch the first candidate element
  */
-static size_t hashtable_compute_hash(hashtable_t *hashtable, char *key);
+static void
+hashtable_prefetch(hashtable_t *hashtable, hashtable_shard_t *shard, uint64_t hash, bool element) {
 
-/******************************************************************************/
-/* Functions                                                                  */
-/******************************************************************************/
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* Prefetch the list of elements, then its first element, the elements being migrated are not prefetched */
+    hashtable_table_t *   table = __atomic_load_n(&shard->table[0], __ATOMIC_ACQUIRE);
+    hashtable_element_t **list  = &table->lists[hash & (table->size - 1)];
+    if (false == element) {
+        __builtin_prefetch(list);
+    } else {
+        hashtable_element_t *curr = __atomic_load_n(list, __ATOMIC_ACQUIRE);
+        if (NULL != curr) {
+            __builtin_prefetch(curr);
+        }
+    }
+}
 
 /**
- * @brief Function used to create hashtable instance
- * @param size Horizontal size of the hashtable
- * @param alloc true if element should be allocated when they are added in the hashtable, false for a copy only
- * @return Hashtable instance if the function succeeded, NULL otherwise
+ * @brief Lookup for several elements, keys are grouped by shard and memory accesses of the lookups are interleaved
+ * @param hashtable Hashtable instance
+ * @param keys Keys of the elements
+ * @param n Number of keys
+ * @param values Elements of the hashtable, NULL if not found, may be NULL
+ * @param bitmap Bitmap of the keys found in the hashtable, may be NULL
+ * @return Number of keys found in the hashtable
  */
-hashtable_t *
-hashtable_create(size_t size, bool alloc) {
+static size_t
+hashtable_lookup_many(hashtable_t *hashtable, char **keys, size_t n, void **values, uint8_t *bitmap) {
 
-    /* Create hashtable instance */
-    hashtable_t *hashtable = (hashtable_t *)malloc(sizeof(hashtable_t));
-    if (NULL == hashtable) {
+    assert(NULL != hashtable);
+
+    uint64_t           hashes[HASHTABLE_BATCH_SIZE];
+    size_t             lens[HASHTABLE_BATCH_SIZE];
+    hashtable_shard_t *shards[HASHTABLE_BATCH_SIZE];
+    size_t             order[HASHTABLE_BATCH_SIZE];
+    size_t             found = 0;
+
+    /* Clear bitmap */
+    if (NULL != bitmap) {
+        memset(bitmap, 0, (n + 7) / 8);
+    }
+
+    /* Keys are processed by batches so that no memory has to be allocated */
+    for (size_t base = 0; base < n; base += HASHTABLE_BATCH_SIZE) {
+        size_t count = (n - base < HASHTABLE_BATCH_SIZE) ? n - base : HASHTABLE_BATCH_SIZE;
+
+        /* Compute hash values of all the keys first */
+        for (size_t index = 0; index < count; index++) {
+            assert(NULL != keys[base + index]);
+            lens[index]   = strlen(keys[base + index]);
+            hashes[index] = hashtable_compute_hash(hashtable, keys[base + index], lens[index]);
+            shards[index] = hashtable_get_shard(hashtable, hashes[index]);
+        }
+
+        /* Parse the shards of the batch, each shard is locked once for all its keys */
+        for (size_t first = 0; first < count; first++) {
+            hashtable_shard_t *shard = shards[first];
+            if (NULL == shard) {
+                /* Key already processed */
+                continue;
+            }
+            size_t m = 0;
+            for (size_t index = first; index < count; index++) {
+                if (shard == shards[index]) {
+                    order[m++]    = index;
+                    shards[index] = NULL;
+                }
+            }
+
+            /* Lock shard for reading */
+            unsigned long epoch = hashtable_lock_read(hashtable, shard);
+
+            /* Migrate some elements if a rehash is in progress, not possible when readers share the shard */
+            if (HASHTABLE_LOCK_MUTEX == hashtable->config.lock) {
+                hashtable_rehash(hashtable, shard, 1);
+            }
+
+            /* Lookup for the elements, the lists of the next keys and then their first elements are prefetched meanwhile */
+            for (size_t step = 0; step < m + 2 * HASHTABLE_PREFETCH_DISTANCE; step++) {
+                if (step < m) {
+                    hashtable_prefetch(hashtable, shard, hashes[order[step]], false);
+                }
+                if ((HASHTABLE_PREFETCH_DISTANCE <= step) && (step - HASHTABLE_PREFETCH_DISTANCE < m)) {
+                    hashtable_prefetch(hashtable, shard, hashes[order[step - HASHTABLE_PREFETCH_DISTANCE]], true);
+                }
+                if (2 * HASHTABLE_PREFETCH_DISTANCE <= step) {
+                    size_t               index = order[step - 2 * HASHTABLE_PREFETCH_DISTANCE];
+                    hashtable_element_t *curr  = hashtable_find_read(hashtable, shard, keys[base + index], lens[index], hashes[index]);
+                    if (NULL != values) {
+                        values[base + index] = (NULL != curr) ? hashtable_value_get(hashtable, curr) : NULL;
+                    }
+                    if (NULL != curr) {
+                        if (NULL != bitmap) {
+                            bitmap[(base + index) / 8] |= (uint8_t)(1 << ((base + index) % 8));
+                        }
+                        found++;
+                    }
+                }
+            }
+
+            /* Unlock shard */
+            hashtable_unlock_read(hashtable, shard, epoch);
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Create a table of lists of elements
+ * @param size Number of lists of elements
+ * @return Table of lists of elements if the function succeeded, NULL otherwise
+ */
+static hashtable_table_t *
+hashtable_table_create(size_t size) {
+
+    /* Create table, lists of elements are allocated with the table */
+    hashtable_table_t *table = (hashtable_table_t *)malloc(sizeof(hashtable_table_t) + size * sizeof(hashtable_element_t *));
+    if (NULL == table) {
         /* Unable to allocate memory */
         return NULL;
     }
-    memset(hashtable, 0, sizeof(hashtable_t));
+    table->size  = size;
+    table->lists = (hashtable_element_t **)(table + 1);
+    memset(table->lists, 0, size * sizeof(hashtable_element_t *));
+
+    return table;
+}
+
+/**
+ * @brief Start resizing the shard, elements are then migrated by the next operations
+ * @param shard Shard of the hashtable
+ * @param size New horizontal size of the shard
+ */
+static void
+hashtable_resize(hashtable_shard_t *shard, size_t size) {
+
+    assert(NULL != shard);
+    assert(NULL == shard->table[1]);
 
-    /* Create table */
-    if (NULL == (hashtable->table = (hashtable_element_t **)malloc(size * sizeof(hashtable_element_t *)))) {
+    /* Create new table, the shard continues with the current table if memory is not available */
+    hashtable_table_t *table = hashtable_table_create(size);
+    if (NULL == table) {
         /* Unable to allocate memory */
-        free(hashtable);
-        return NULL;
+        return;
     }
-    memset(hashtable->table, 0, size * sizeof(hashtable_element_t *));
 
-    /* Save size and alloc flag */
-    hashtable->size  = size;
-    hashtable->alloc = alloc;
+    /* Start migration of the elements */
+    shard->rehash = 0;
+    __atomic_store_n(&shard->table[1], table, __ATOMIC_RELEASE);
+}
 
-    /* Initialize semaphore used to access the hashtable */
-    sem_init(&hashtable->sem, 0, 1);
+/**
+ * @brief Check load factor of the shard and start resizing it if required
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ */
+static void
+hashtable_check_load(hashtable_t *hashtable, hashtable_shard_t *shard) {
 
-    return hashtable;
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* Nothing to do if a rehash is already in progress */
+    if (NULL != shard->table[1]) {
+        return;
+    }
+
+    /* Grow or shrink the table */
+    size_t size = shard->table[0]->size;
+    if ((true == hashtable->config.grow) && (shard->count > size * HASHTABLE_GROW_LOAD_FACTOR)) {
+        hashtable_resize(shard, size * 2);
+    } else if ((true == hashtable->config.shrink) && (size > hashtable->shard_size) && (shard->count * HASHTABLE_SHRINK_LOAD_FACTOR < size)) {
+        hashtable_resize(shard, (size / 2 > hashtable->shard_size) ? size / 2 : hashtable->shard_size);
+    }
 }
 
 /**
- * @brief Add element to the hashtable
+ * @brief Migrate some lists of elements from table[0] to table[1] when a rehash of the shard is in progress
  * @param hashtable Hashtable instance
- * @param key Key of the element to be added
- * @param e Element to be added in the hashtable
- * @param size Size of the element to be added
- * @return 0 if the function succeeded, -1 otherwise
+ * @param shard Shard of the hashtable
+ * @param step Number of lists of elements to be migrated
  */
-int
-hashtable_add(hashtable_t *hashtable, char *key, void *e, size_t size) {
+static void
+hashtable_rehash(hashtable_t *hashtable, hashtable_shard_t *shard, size_t step) {
 
     assert(NULL != hashtable);
-    assert(NULL != key);
+    assert(NULL != shard);
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+    /* Nothing to do if no rehash is in progress */
+    if (NULL == shard->table[1]) {
+        return;
+    }
 
-    /* Compute hash value of the wanted key */
-    size_t hash = hashtable_compute_hash(hashtable, key);
-
-    /* Check if the element already exist, update the element in this case */
-    hashtable_element_t *last = NULL;
-    hashtable_element_t *curr = hashtable->table[hash];
-    while (NULL != curr) {
-        if (!strcmp(curr->key, key)) {
-            /* Element found */
-            if ((true == hashtable->alloc) && (NULL != curr->e)) {
-                free(curr->e);
-                curr->e = NULL;
-            }
-            if ((true == hashtable->alloc) && (NULL != e) && (0 != size)) {
-                if (NULL == (curr->e = malloc(size))) {
-                    /* Unable to allocate memory */
-                    sem_post(&hashtable->sem);
-                    return -1;
-                }
-                memcpy(curr->e, e, size);
-            } else {
-                curr->e = e;
+    /* Readers parsing the migrated elements must do their lookup again */
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    /* Migrate lists of elements, the number of empty lists visited is also limited to bound the duration */
+    hashtable_table_t *from  = shard->table[0];
+    hashtable_table_t *to    = shard->table[1];
+    size_t             empty = step * 10;
+    while ((0 < step) && (shard->rehash < from->size)) {
+        hashtable_element_t *curr = from->lists[shard->rehash];
+        if (NULL == curr) {
+            shard->rehash++;
+            if (0 == --empty) {
+                break;
             }
-            sem_post(&hashtable->sem);
-            return 0;
+            continue;
+        }
+        while (NULL != curr) {
+            hashtable_element_t *next = curr->next;
+            size_t               hash = curr->hash & (to->size - 1);
+            __atomic_store_n(&curr->next, to->lists[hash], __ATOMIC_RELAXED);
+            __atomic_store_n(&to->lists[hash], curr, __ATOMIC_RELEASE);
+            curr = next;
         }
-        last = curr;
-        curr = curr->next;
+        __atomic_store_n(&from->lists[shard->rehash], NULL, __ATOMIC_RELAXED);
+        shard->rehash++;
+        step--;
     }
 
-    /* Element not found, create a new hashtable element */
-    hashtable_element_t *hashtable_element = (hashtable_element_t *)malloc(sizeof(hashtable_element_t));
-    if (NULL == hashtable_element) {
-        /* Unable to allocate memory */
-        sem_post(&hashtable->sem);
-        return -1;
+    /* Replace table when the migration is completed, the previous table may still be accessed by readers */
+    if (shard->rehash >= from->size) {
+        __atomic_store_n(&shard->table[0], to, __ATOMIC_RELEASE);
+        __atomic_store_n(&shard->table[1], NULL, __ATOMIC_RELEASE);
+        shard->rehash = 0;
+        hashtable_retire(hashtable, shard, from, HASHTABLE_RETIRED_MEMORY, 0);
     }
-    memset(hashtable_element, 0, sizeof(hashtable_element_t));
 
-    /* Store key */
-    if (NULL == (hashtable_element->key = strdup(key))) {
-        /* Unable to allocate memory */
-        free(hashtable_element);
-        sem_post(&hashtable->sem);
-        return -1;
+    /* End of migration */
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Release memory block which may still be accessed by readers, release is deferred in HASHTABLE_LOCK_RCU mode or while snapshots reference it
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param ptr Memory block to be released
+ * @param type Type of the memory block
+ * @param version Version of the element when the value has been stored, only used if the memory block is a value
+ */
+static void
+hashtable_retire(hashtable_t *hashtable, hashtable_shard_t *shard, void *ptr, hashtable_retired_type_t type, uint64_t version) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != ptr);
+
+    /* Elements are kept while snapshots of the shard are pending because history records may reference their keys, values owned by the hashtable
+     * without reference counter are kept while a snapshot includes them, snapshots hold their own reference otherwise */
+    uint64_t replaced = __atomic_load_n(&shard->version, __ATOMIC_RELAXED);
+    if ((HASHTABLE_RETIRED_VALUE != type) || (true == hashtable->config.refcount) || (false == hashtable_snapshot_covers(shard, version, replaced))) {
+        replaced = 0;
     }
 
-    /* Store element */
-    if ((true == hashtable->alloc) && (NULL != e) && (0 != size)) {
-        if (NULL == (hashtable_element->e = malloc(size))) {
-            /* Unable to allocate memory */
-            free(hashtable_element->key);
-            free(hashtable_element);
-            sem_post(&hashtable->sem);
-            return -1;
+    /* Memory block can be released immediately if readers lock the shard and if it is not referenced by a snapshot */
+    hashtable_retired_t *retired = NULL;
+    if ((0 != replaced) || ((HASHTABLE_RETIRED_ELEMENT == type) && (0 < shard->pending))) {
+        /* Snapshots are not taken while the shard is locked for writing, the retired memory blocks have been allocated in advance */
+        assert(NULL != shard->spare);
+        retired      = shard->spare;
+        shard->spare = retired->next;
+        shard->spare_count--;
+    } else if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        if (NULL == (retired = (hashtable_retired_t *)malloc(sizeof(hashtable_retired_t)))) {
+            /* Unable to allocate memory, wait for all readers to exit the current epoch */
+            unsigned long epoch = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+            while (__atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST) < epoch + 2) {
+                hashtable_epoch_advance(hashtable);
+            }
         }
-        memcpy(hashtable_element->e, e, size);
-    } else {
-        hashtable_element->e = e;
+    }
+    if (NULL == retired) {
+        hashtable_retired_free(hashtable, ptr, type);
+        return;
     }
 
-    /* Add element to the hashtable */
-    if (NULL == last) {
-        hashtable->table[hash] = hashtable_element;
+    /* Add memory block to the list of memory blocks referenced by snapshots, or to the list of retired memory blocks of the shard */
+    retired->epoch    = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+    retired->ptr      = ptr;
+    retired->type     = type;
+    retired->version  = version;
+    retired->replaced = replaced;
+    if (true == hashtable_retired_pinned(shard, retired)) {
+        retired->next = shard->pinned;
+        shard->pinned = retired;
     } else {
-        last->next = hashtable_element;
+        hashtable_retired_append(hashtable, shard, retired);
     }
-    hashtable->count++;
-
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
-
-    return 0;
 }
 
 /**
- * @brief Get number of element in the hashtable
+ * @brief Add memory block to the list of retired memory blocks of the shard, which are released once readers are done
  * @param hashtable Hashtable instance
- * @return Number of elements in the hashtable
+ * @param shard Shard of the hashtable locked for writing
+ * @param retired Retired memory block
  */
-size_t
-hashtable_get_count(hashtable_t *hashtable) {
+static void
+hashtable_retired_append(hashtable_t *hashtable, hashtable_shard_t *shard, hashtable_retired_t *retired) {
 
     assert(NULL != hashtable);
+    assert(NULL != shard);
+    assert(NULL != retired);
 
-    size_t count = 0;
+    /* Add memory block at the end of the list */
+    retired->next = NULL;
+    if (NULL == shard->retired_tail) {
+        shard->retired = retired;
+    } else {
+        shard->retired_tail->next = retired;
+    }
+    shard->retired_tail = retired;
+    shard->retired_count++;
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+    /* Try to release retired memory blocks */
+    if (HASHTABLE_RECLAIM_THRESHOLD <= shard->retired_count) {
+        hashtable_reclaim(hashtable, shard);
+    }
+}
+
+/**
+ * @brief Check if a retired memory block is still referenced by snapshots of the shard
+ * @param shard Shard of the hashtable locked for writing
+ * @param retired Retired memory block
+ * @return true if the memory block is referenced by snapshots, false otherwise
+ */
+static bool
+hashtable_retired_pinned(hashtable_shard_t *shard, hashtable_retired_t *retired) {
 
-    /* Get number of elements */
-    count = hashtable->count;
+    assert(NULL != shard);
+    assert(NULL != retired);
 
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
+    /* Elements are referenced by history records while snapshots are pending, values by the snapshots including them */
+    if (HASHTABLE_RETIRED_ELEMENT == retired->type) {
+        return (0 < shard->pending);
+    }
 
-    return count;
+    return (0 != retired->replaced) && (true == hashtable_snapshot_covers(shard, retired->version, retired->replaced));
 }
 
 /**
- * @brief Check if key is present in the hashtable
+ * @brief Move the memory blocks which are not referenced by snapshots anymore to the list of retired memory blocks, called when a snapshot is done
  * @param hashtable Hashtable instance
- * @param key Key of the element
- * @return true if the key is found, false otherwise
+ * @param shard Shard of the hashtable locked for writing
  */
-bool
-hashtable_has_key(hashtable_t *hashtable, char *key) {
+static void
+hashtable_unpin(hashtable_t *hashtable, hashtable_shard_t *shard) {
 
     assert(NULL != hashtable);
-    assert(NULL != key);
+    assert(NULL != shard);
+
+    /* Parse the memory blocks referenced by snapshots */
+    hashtable_retired_t **link = &shard->pinned;
+    while (NULL != *link) {
+        hashtable_retired_t *tmp = *link;
+        if (true == hashtable_retired_pinned(shard, tmp)) {
+            link = &tmp->next;
+        } else {
+            *link = tmp->next;
+            hashtable_retired_append(hashtable, shard, tmp);
+        }
+    }
 
-    bool found = false;
+    /* Release the memory blocks which can not be accessed by readers anymore */
+    if (NULL != shard->retired) {
+        hashtable_reclaim(hashtable, shard);
+    }
+}
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+/**
+ * @brief Allocate in advance the memory needed to retire elements and values while snapshots exist, and to record the element modified
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ * @param count Number of elements and values which may be retired
+ * @return 0 if the function succeeded, -1 otherwise
+ */
+static int
+hashtable_retire_reserve(hashtable_t *hashtable, hashtable_shard_t *shard, size_t count) {
 
-    /* Compute hash value of the wanted key */
-    size_t hash = hashtable_compute_hash(hashtable, key);
+    assert(NULL != hashtable);
+    assert(NULL != shard);
 
-    /* Lookup for the wanted element */
-    hashtable_element_t *curr = hashtable->table[hash];
-    while (NULL != curr) {
-        if (!strcmp(curr->key, key)) {
-            /* Element found */
-            found = true;
-            break;
+    /* Elements and values can be released immediately, or after readers are done even if memory can not be allocated, unless snapshots exist */
+    if (NULL == shard->cuts) {
+        return 0;
+    }
+
+    /* Allocate the history record if snapshots of the shard are pending, so that the operation fails before the element is modified */
+    if ((0 < shard->pending) && (NULL == shard->history_spare)) {
+        if (NULL == (shard->history_spare = (hashtable_history_t *)malloc(sizeof(hashtable_history_t)))) {
+            /* Unable to allocate memory */
+            return -1;
         }
-        curr = curr->next;
     }
 
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
+    /* Allocate the missing retired memory blocks, so that the operation fails before the elements and values are unlinked */
+    while (shard->spare_count < count) {
+        hashtable_retired_t *retired = (hashtable_retired_t *)malloc(sizeof(hashtable_retired_t));
+        if (NULL == retired) {
+            /* Unable to allocate memory */
+            return -1;
+        }
+        retired->next = shard->spare;
+        shard->spare  = retired;
+        shard->spare_count++;
+    }
 
-    return found;
+    return 0;
 }
 
 /**
- * @brief Get all keys of the hashtable
+ * @brief Release memory block which can not be accessed by readers anymore
  * @param hashtable Hashtable instance
- * @param keys Keys of the hashtable (free required)
- * @return Number of element of the hashtable
+ * @param ptr Memory block to be released
+ * @param type Type of the memory block
  */
-size_t
-hashtable_get_keys(hashtable_t *hashtable, char ***keys) {
+static void
+hashtable_retired_free(hashtable_t *hashtable, void *ptr, hashtable_retired_type_t type) {
 
     assert(NULL != hashtable);
+    assert(NULL != ptr);
 
-    size_t count = 0;
+    /* Release the memory block according to its type */
+    if (HASHTABLE_RETIRED_ELEMENT == type) {
+        hashtable_element_free((hashtable_element_t *)ptr);
+    } else if (HASHTABLE_RETIRED_VALUE == type) {
+        hashtable_value_put(hashtable, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+/**
+ * @brief Release retired memory blocks of the shard which can not be accessed by readers anymore
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable locked for writing
+ */
+static void
+hashtable_reclaim(hashtable_t *hashtable, hashtable_shard_t *shard) {
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+    assert(NULL != hashtable);
+    assert(NULL != shard);
 
-    /* Get number of elements */
-    count = hashtable->count;
+    /* Advance epoch if possible */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        hashtable_epoch_advance(hashtable);
+    }
 
-    /* Check if at least one element is in the hashtable */
-    if (0 < count) {
+    /* Memory blocks retired two epochs ago can not be accessed by readers anymore, readers lock the shard in other modes */
+    unsigned long epoch = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+    while ((NULL != shard->retired) && ((HASHTABLE_LOCK_RCU != hashtable->config.lock) || (shard->retired->epoch + 2 <= epoch))) {
+        hashtable_retired_t *tmp = shard->retired;
+        shard->retired           = shard->retired->next;
+        hashtable_retired_free(hashtable, tmp->ptr, tmp->type);
+        free(tmp);
+        shard->retired_count--;
+    }
+    if (NULL == shard->retired) {
+        shard->retired_tail = NULL;
+    }
+}
 
-        /* Create table of keys */
-        if (NULL != (*keys = (char **)malloc(count * sizeof(char *)))) {
+/**
+ * @brief Create the key releasing the reader slot of the threads when they exit, called once
+ */
+static void
+hashtable_epoch_init(void) {
 
-            /* Parse table and store keys */
-            size_t index = 0;
-            for (size_t hash = 0; hash < hashtable->size; hash++) {
-                hashtable_element_t *curr = hashtable->table[hash];
-                while (NULL != curr) {
-                    (*keys)[index] = curr->key;
-                    index++;
-                    curr = curr->next;
-                }
-            }
-        }
+    /* The destructor of the key is called at thread exit if a reader slot has been given to the thread */
+    pthread_key_create(&hashtable_epoch_key, hashtable_epoch_release);
+}
+
+/**
+ * @brief Give a reader slot to the current thread, the least used slot with the lowest index is chosen so that free slots are used first
+ * @return Reader slot of the current thread
+ */
+static size_t
+hashtable_epoch_acquire(void) {
+
+    /* Choose the slot, slots are shared once all of them are used */
+    pthread_once(&hashtable_epoch_once, hashtable_epoch_init);
+    pthread_mutex_lock(&hashtable_epoch_mutex);
+    size_t slot = 0;
+    for (size_t index = 1; index < HASHTABLE_EPOCH_SLOTS; index++) {
+        slot = (hashtable_epoch_users[index] < hashtable_epoch_users[slot]) ? index : slot;
     }
+    hashtable_epoch_users[slot]++;
+    pthread_mutex_unlock(&hashtable_epoch_mutex);
 
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
+    /* Record the slot so that it is given back when the thread exits, a NULL value would not call the destructor */
+    pthread_setspecific(hashtable_epoch_key, (void *)(uintptr_t)(slot + 1));
 
-    return count;
+    return slot;
 }
 
 /**
- * @brief Lookup element of the hashtable
- * @param hashtable Hashtable instance
- * @param key Key of the element
- * @return Element of the hashtable, NULL if not found
+ * @brief Give the reader slot of a thread back when it exits
+ * @param value Reader slot of the thread plus one
  */
-void *
-hashtable_lookup(hashtable_t *hashtable, char *key) {
+static void
+hashtable_epoch_release(void *value) {
 
-    assert(NULL != hashtable);
-    assert(NULL != key);
+    assert(NULL != value);
 
-    void *e = NULL;
+    /* The thread is not inside an epoch anymore, its slot can be given to another thread */
+    pthread_mutex_lock(&hashtable_epoch_mutex);
+    hashtable_epoch_users[(uintptr_t)value - 1]--;
+    pthread_mutex_unlock(&hashtable_epoch_mutex);
+    hashtable_epoch_slot = (size_t)-1;
+}
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+/**
+ * @brief Enter the current epoch, memory blocks retired from now are not released until the reader exits
+ * @param hashtable Hashtable instance
+ * @return Epoch entered by the reader
+ */
+static unsigned long
+hashtable_epoch_enter(hashtable_t *hashtable) {
 
-    /* Compute hash value of the wanted key */
-    size_t hash = hashtable_compute_hash(hashtable, key);
+    assert(NULL != hashtable);
 
-    /* Lookup for the wanted element */
-    hashtable_element_t *curr = hashtable->table[hash];
-    while (NULL != curr) {
-        if (!strcmp(curr->key, key)) {
-            /* Element found */
-            e = curr->e;
-            break;
-        }
-        curr = curr->next;
+    /* Retrieve reader slot of the current thread */
+    if ((size_t)-1 == hashtable_epoch_slot) {
+        hashtable_epoch_slot = hashtable_epoch_acquire();
     }
+    hashtable_epoch_slot_t *slot = &hashtable->slots[hashtable_epoch_slot];
 
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
-
-    return e;
+    /* Enter the current epoch, check it has not been advanced in the meantime */
+    while (true) {
+        unsigned long epoch = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&slot->active[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        if (epoch == __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST)) {
+            return epoch;
+        }
+        __atomic_fetch_sub(&slot->active[epoch & 1], 1, __ATOMIC_SEQ_CST);
+    }
 }
 
 /**
- * @brief Remove element of the hashtable
+ * @brief Exit epoch previously entered by the reader
  * @param hashtable Hashtable instance
- * @param key Key of the element
- * @return Head element of the hashtable, NULL if not found
+ * @param epoch Epoch entered by the reader
  */
-void *
-hashtable_remove(hashtable_t *hashtable, char *key) {
+static void
+hashtable_epoch_exit(hashtable_t *hashtable, unsigned long epoch) {
 
     assert(NULL != hashtable);
-    assert(NULL != key);
 
-    void *e = NULL;
+    /* Exit the epoch */
+    __atomic_fetch_sub(&hashtable->slots[hashtable_epoch_slot].active[epoch & 1], 1, __ATOMIC_RELEASE);
+}
 
-    /* Wait semaphore */
-    sem_wait(&hashtable->sem);
+/**
+ * @brief Advance the current epoch if all readers of the previous epoch have exited
+ * @param hashtable Hashtable instance
+ */
+static void
+hashtable_epoch_advance(hashtable_t *hashtable) {
 
-    /* Compute hash value of the wanted key */
-    size_t hash = hashtable_compute_hash(hashtable, key);
+    assert(NULL != hashtable);
 
-    /* Lookup for the wanted element */
-    hashtable_element_t *last = NULL;
-    hashtable_element_t *curr = hashtable->table[hash];
-    while (NULL != curr) {
-        if (!strcmp(curr->key, key)) {
-            /* Element found */
-            e = curr->e;
-            /* Update the list of elements */
-            if (NULL == last) {
-                hashtable->table[hash] = curr->next;
-            } else {
-                last->next = curr->next;
-            }
-            /* Release memory */
-            free(curr->key);
-            free(curr);
-            break;
+    /* Check all readers of the previous epoch have exited, the next epoch has the same parity */
+    unsigned long epoch = __atomic_load_n(&hashtable->epoch, __ATOMIC_SEQ_CST);
+    for (size_t index = 0; index < HASHTABLE_EPOCH_SLOTS; index++) {
+        if (0 != __atomic_load_n(&hashtable->slots[index].active[(epoch + 1) & 1], __ATOMIC_SEQ_CST)) {
+            return;
         }
-        last = curr;
-        curr = curr->next;
     }
 
-    /* Release semaphore */
-    sem_post(&hashtable->sem);
-
-    return e;
+    /* Advance epoch, another writer may have done it in the meantime */
+    __atomic_compare_exchange_n(&hashtable->epoch, &epoch, epoch + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 }
 
 /**
- * @brief Release hashtable instance
+ * @brief Lock the shard for reading
+ * The access is shared with other readers in HASHTABLE_LOCK_RWLOCK mode, and no lock is taken in HASHTABLE_LOCK_RCU mode.
  * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @return Epoch entered by the reader in HASHTABLE_LOCK_RCU mode, 0 otherwise
  */
-void
-hashtable_release(hashtable_t *hashtable) {
+static unsigned long
+hashtable_lock_read(hashtable_t *hashtable, hashtable_shard_t *shard) {
 
-    /* Release hashtable instance */
-    if (NULL != hashtable) {
+    assert(NULL != hashtable);
+    assert(NULL != shard);
 
-        /* Wait semaphore */
-        sem_wait(&hashtable->sem);
+    /* Wait semaphore or read-write lock, or enter current epoch */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        return hashtable_epoch_enter(hashtable);
+    } else if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+        pthread_rwlock_rdlock(&shard->rwlock);
+    } else {
+        sem_wait(&shard->sem);
+    }
 
-        /* Release hashtable elements */
-        for (size_t hash = 0; hash < hashtable->size; hash++) {
-            hashtable_element_t *curr = hashtable->table[hash];
-            while (NULL != curr) {
-                hashtable_element_t *tmp = curr;
-                curr                     = curr->next;
-                free(tmp->key);
-                if ((true == hashtable->alloc) && (NULL != tmp->e)) {
-                    free(tmp->e);
-                }
-                free(tmp);
-            }
-        }
+    return 0;
+}
 
-        /* Release table */
-        free(hashtable->table);
+/**
+ * @brief Unlock the shard locked for reading
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ * @param epoch Epoch returned by hashtable_lock_read
+ */
+static void
+hashtable_unlock_read(hashtable_t *hashtable, hashtable_shard_t *shard, unsigned long epoch) {
 
-        /* Release semaphore */
-        sem_post(&hashtable->sem);
-        sem_close(&hashtable->sem);
+    assert(NULL != hashtable);
+    assert(NULL != shard);
 
-        /* Release hashtable instance */
-        free(hashtable);
+    /* Release semaphore or read-write lock, or exit epoch */
+    if (HASHTABLE_LOCK_RCU == hashtable->config.lock) {
+        hashtable_epoch_exit(hashtable, epoch);
+    } else if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+        pthread_rwlock_unlock(&shard->rwlock);
+    } else {
+        sem_post(&shard->sem);
     }
 }
 
 /**
- * @brief Compute hash value of the wanted key
+ * @brief Lock the shard for writing, the access is exclusive
  * @param hashtable Hashtable instance
- * @param key Key as string
- * @return Hash value modulo hashtable size to be used in the hashtable table
+ * @param shard Shard of the hashtable
  */
-static size_t
-hashtable_compute_hash(hashtable_t *hashtable, char *key) {
+static void
+hashtable_lock_write(hashtable_t *hashtable, hashtable_shard_t *shard) {
 
     assert(NULL != hashtable);
-    assert(NULL != key);
+    assert(NULL != shard);
 
-    /* Compute djb2 hash */
-    int           c;
-    unsigned long hash = 5381;
-    while (0 != (c = *key++)) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    /* Wait semaphore or read-write lock */
+    if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+        pthread_rwlock_wrlock(&shard->rwlock);
+    } else {
+        sem_wait(&shard->sem);
     }
+}
 
-    return hash % hashtable->size;
+/**
+ * @brief Unlock the shard locked for writing
+ * @param hashtable Hashtable instance
+ * @param shard Shard of the hashtable
+ */
+static void
+hashtable_unlock(hashtable_t *hashtable, hashtable_shard_t *shard) {
+
+    assert(NULL != hashtable);
+    assert(NULL != shard);
+
+    /* Release semaphore or read-write lock */
+    if (HASHTABLE_LOCK_RWLOCK == hashtable->config.lock) {
+        pthread_rwlock_unlock(&shard->rwlock);
+    } else {
+        sem_post(&shard->sem);
+    }
 }
@@ -0,0 +1,1561 @@
+/**
+ * @file      hashtable_test.c
+ * @brief     Hashtable tests in C
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021-2023 joelguittet and c-hashtable contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hashtable.h"
+
+/******************************************************************************/
+/* Definitions                                                                */
+/******************************************************************************/
+
+/**
+ * Check a condition, the test fails and returns if it is false
+ */
+#define HASHTABLE_TEST_CHECK(cond)                                          \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return -1;                                                      \
+        }                                                                   \
+    } while (0)
+
+/**
+ * Number of elements added by the tests of the growing hashtable
+ */
+#define HASHTABLE_TEST_COUNT (10000)
+
+/**
+ * Number of threads of the multi-threaded tests
+ */
+#define HASHTABLE_TEST_THREADS (4)
+
+/******************************************************************************/
+/* Types                                                                      */
+/******************************************************************************/
+
+/**
+ * Thread of the multi-threaded tests
+ */
+typedef struct {
+    pthread_t    thread;    /**< Thread identifier */
+    hashtable_t *hashtable; /**< Hashtable shared by the threads */
+    int          index;     /**< Index of the thread, used to build its own keys */
+    int          ret;       /**< Result of the thread, 0 if its checks succeeded, -1 otherwise */
+} hashtable_test_thread_t;
+
+/******************************************************************************/
+/* Variables                                                                  */
+/******************************************************************************/
+
+/**
+ * Seed given to the last call of hashtable_test_hash_fct
+ */
+static uint64_t hashtable_test_hash_seed = 0;
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+
+/**
+ * @brief Mark the visited elements, used by hashtable_test_scan
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable
+ * @param user Flags of the elements added before the scan, indexed by their value
+ */
+static void hashtable_test_scan_cb(const char *key, size_t key_len, void *e, void *user);
+
+/**
+ * @brief Load the element of a key, the element is the key itself
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param size Size of the element
+ * @param user Number of calls
+ * @return Element loaded
+ */
+static void *hashtable_test_load(const void *key, size_t key_len, size_t *size, void *user);
+
+/**
+ * @brief Hash function giving the same hash value to all keys, used by hashtable_test_hash
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param seed Seed of the hashtable, recorded in hashtable_test_hash_seed
+ * @return Seed of the hashtable
+ */
+static uint64_t hashtable_test_hash_fct(const void *key, size_t key_len, uint64_t seed);
+
+/**
+ * @brief Add the same keys to two hashtables with the wanted hash function and seeds and compare the order of their keys, used by hashtable_test_hash
+ * @param hash Hash function of the hashtables
+ * @param seed1 Seed of the first hashtable
+ * @param seed2 Seed of the second hashtable
+ * @param same Flag set if the keys of both hashtables are in the same order
+ * @return 0 if the keys are found in both hashtables, -1 otherwise
+ */
+static int hashtable_test_hash_order(hashtable_hash_t hash, uint64_t seed1, uint64_t seed2, bool *same);
+
+/**
+ * @brief Store the element given as user data, used by hashtable_test_admission
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param found true if the key is found
+ * @param e Element of the hashtable, replaced by the element to be stored
+ * @param size Size of the element, replaced by the size of the element to be stored
+ * @param user Element to be stored, an int
+ * @return HASHTABLE_COMPUTE_SET
+ */
+static hashtable_compute_t hashtable_test_compute_set(const char *key, size_t key_len, bool found, void **e, size_t *size, void *user);
+
+/**
+ * @brief Increment the element in place, used by hashtable_test_callbacks
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable, an int
+ * @param size Size of the element
+ * @param user Unused
+ */
+static void hashtable_test_value_incr(const char *key, size_t key_len, void *e, size_t size, void *user);
+
+/**
+ * @brief Increment the element in place if it is found, used by hashtable_test_callbacks
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param found true if the key is found
+ * @param e Element of the hashtable, an int
+ * @param size Size of the element
+ * @param user Action to be returned
+ * @return Action given as user data
+ */
+static hashtable_compute_t hashtable_test_compute_incr(const char *key, size_t key_len, bool found, void **e, size_t *size, void *user);
+
+/**
+ * @brief Add, lookup and remove elements of the thread while the elements shared by all threads are looked up, used by hashtable_test_threads
+ * @param arg Thread of the test
+ * @return Thread of the test, with the result of its checks
+ */
+static void *hashtable_test_thread(void *arg);
+
+/**
+ * @brief Run the checks of a thread, used by hashtable_test_thread
+ * @param thread Thread of the test
+ * @return 0 if the checks succeeded, -1 otherwise
+ */
+static int hashtable_test_thread_run(hashtable_test_thread_t *thread);
+
+/**
+ * @brief Increment the counter shared by all threads, used by hashtable_test_incr
+ * @param arg Thread of the test
+ * @return Thread of the test, with the result of its checks
+ */
+static void *hashtable_test_incr_thread(void *arg);
+
+/**
+ * @brief Check that the hashtable grows and shrinks while elements are added and removed
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_resize(void);
+
+/**
+ * @brief Check that a full scan visits all elements, even if the hashtable is resized between two calls
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_scan(void);
+
+/**
+ * @brief Check that a snapshot is not modified by the elements added, replaced and removed afterwards
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_snapshot(void);
+
+/**
+ * @brief Check that elements expire after their time to live
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_ttl(void);
+
+/**
+ * @brief Check that bounded hashtables evict elements and do not admit keys loaded once in place of frequent ones
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_eviction(void);
+
+/**
+ * @brief Check that reference counted values remain valid once removed or replaced
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_refcount(void);
+
+/**
+ * @brief Check that elements are only replaced if their version matches
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_version(void);
+
+/**
+ * @brief Check that threads adding, looking up and removing elements concurrently do not lose any of them
+ * @param lock Locking mode of the hashtable
+ * @param shards Number of shards of the hashtable
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_threads(hashtable_lock_t lock, size_t shards);
+
+/**
+ * @brief Check that binary keys containing NUL characters are distinct from their prefixes and from each other
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_binary(void);
+
+/**
+ * @brief Check that the hash functions are selected and seeded as configured, and that keys colliding on the whole hash value are distinct
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_hash(void);
+
+/**
+ * @brief Check that batched lookups find the same elements as single lookups, across shards and groups of keys
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_batch(void);
+
+/**
+ * @brief Check that bulk additions update the existing elements and the duplicated keys, and that their blocks are released with their elements
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_bulk(void);
+
+/**
+ * @brief Check that pre-hashed keys are reused by hashtables sharing their hash function and seed, and hashed again by the other ones
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_prehashed(void);
+
+/**
+ * @brief Check that entries update and remove their element, and are not valid anymore once an element of their shard has been removed
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_entry(void);
+
+/**
+ * @brief Check that elements are only added by lookup_or_add and lookup_or_create if their key is not found, and that replace returns the previous element
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_upsert(void);
+
+/**
+ * @brief Check that counters are created and incremented, including by concurrent threads without lock
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_incr(void);
+
+/**
+ * @brief Check that bounded hashtables evict elements to stay within their memory and do not add elements larger than it
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_memory(void);
+
+/**
+ * @brief Check that compute, add_if_version and incr do not add elements which are not admitted
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_admission(void);
+
+/**
+ * @brief Check that elements are copied into buffers, truncated to their length, with the size they have been added with
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_copy(void);
+
+/**
+ * @brief Check that with_value and compute modify the elements in place, while the snapshots keep the elements they have taken
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int hashtable_test_callbacks(void);
+
+/******************************************************************************/
+/* Functions                                                                  */
+/******************************************************************************/
+
+/**
+ * @brief Main function
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return 0 if all tests succeeded, 1 otherwise
+ */
+int
+main(int argc, char **argv) {
+
+    int ret = 0;
+
+    /* Run tests */
+    ret |= hashtable_test_resize();
+    ret |= hashtable_test_scan();
+    ret |= hashtable_test_snapshot();
+    ret |= hashtable_test_ttl();
+    ret |= hashtable_test_eviction();
+    ret |= hashtable_test_refcount();
+    ret |= hashtable_test_version();
+    ret |= hashtable_test_threads(HASHTABLE_LOCK_RWLOCK, 1);
+    ret |= hashtable_test_threads(HASHTABLE_LOCK_RWLOCK, 8);
+    ret |= hashtable_test_threads(HASHTABLE_LOCK_MUTEX, 8);
+    ret |= hashtable_test_binary();
+    ret |= hashtable_test_hash();
+    ret |= hashtable_test_batch();
+    ret |= hashtable_test_bulk();
+    ret |= hashtable_test_prehashed();
+    ret |= hashtable_test_entry();
+    ret |= hashtable_test_upsert();
+    ret |= hashtable_test_incr();
+    ret |= hashtable_test_memory();
+    ret |= hashtable_test_admission();
+    ret |= hashtable_test_copy();
+    ret |= hashtable_test_callbacks();
+
+    return (0 == ret) ? 0 : 1;
+}
+
+/**
+ * @brief Mark the visited elements, used by hashtable_test_scan
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable
+ * @param user Flags of the elements added before the scan, indexed by their value
+ */
+static void
+hashtable_test_scan_cb(const char *key, size_t key_len, void *e, void *user) {
+
+    /* Elements added during the scan have their own prefix */
+    if (0 == strncmp(key, "key", 3)) {
+        ((bool *)user)[*(int *)e] = true;
+    }
+}
+
+/**
+ * @brief Load the element of a key, the element is the key itself
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param size Size of the element
+ * @param user Number of calls
+ * @return Element loaded
+ */
+static void *
+hashtable_test_load(const void *key, size_t key_len, size_t *size, void *user) {
+
+    (*(size_t *)user)++;
+
+    /* The element belongs to the hashtable and is released once copied */
+    char *e = (char *)malloc(key_len + 1);
+    if (NULL != e) {
+        memcpy(e, key, key_len);
+        e[key_len] = '\0';
+        *size      = key_len + 1;
+    }
+
+    return e;
+}
+
+/**
+ * @brief Hash function giving the same hash value to all keys, used by hashtable_test_hash
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param seed Seed of the hashtable, recorded in hashtable_test_hash_seed
+ * @return Seed of the hashtable
+ */
+static uint64_t
+hashtable_test_hash_fct(const void *key, size_t key_len, uint64_t seed) {
+
+    hashtable_test_hash_seed = seed;
+
+    return seed;
+}
+
+/**
+ * @brief Add the same keys to two hashtables with the wanted hash function and seeds and compare the order of their keys, used by hashtable_test_hash
+ * @param hash Hash function of the hashtables
+ * @param seed1 Seed of the first hashtable
+ * @param seed2 Seed of the second hashtable
+ * @param same Flag set if the keys of both hashtables are in the same order
+ * @return 0 if the keys are found in both hashtables, -1 otherwise
+ */
+static int
+hashtable_test_hash_order(hashtable_hash_t hash, uint64_t seed1, uint64_t seed2, bool *same) {
+
+    hashtable_config_t config;
+    hashtable_t *      hashtable[2];
+    char **            keys[2];
+    char               key[32];
+
+    /* Create hashtable instances and add the same keys in the same order */
+    hashtable_config_init(&config);
+    config.alloc = true;
+    config.hash  = hash;
+    config.seed  = seed1;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[0] = hashtable_create_with_config(&config)));
+    config.seed = seed2;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[1] = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 1000; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable[0], key, &index, sizeof(index)));
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable[1], key, &index, sizeof(index)));
+    }
+    for (int index = 0; index < 1000; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable[0], key));
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable[1], key));
+    }
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable[0], "key1000"));
+
+    /* Keys are returned in the order of their hash values, which only depends on the hash function and the seed */
+    HASHTABLE_TEST_CHECK(1000 == hashtable_get_keys(hashtable[0], &keys[0]));
+    HASHTABLE_TEST_CHECK(1000 == hashtable_get_keys(hashtable[1], &keys[1]));
+    *same = true;
+    for (int index = 0; index < 1000; index++) {
+        if (0 != strcmp(keys[0][index], keys[1][index])) {
+            *same = false;
+        }
+    }
+
+    /* Release memory */
+    free(keys[0]);
+    free(keys[1]);
+    hashtable_release(hashtable[0]);
+    hashtable_release(hashtable[1]);
+
+    return 0;
+}
+
+/**
+ * @brief Store the element given as user data, used by hashtable_test_admission
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param found true if the key is found
+ * @param e Element of the hashtable, replaced by the element to be stored
+ * @param size Size of the element, replaced by the size of the element to be stored
+ * @param user Element to be stored, an int
+ * @return HASHTABLE_COMPUTE_SET
+ */
+static hashtable_compute_t
+hashtable_test_compute_set(const char *key, size_t key_len, bool found, void **e, size_t *size, void *user) {
+
+    *e    = user;
+    *size = sizeof(int);
+
+    return HASHTABLE_COMPUTE_SET;
+}
+
+/**
+ * @brief Increment the element in place, used by hashtable_test_callbacks
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param e Element of the hashtable, an int
+ * @param size Size of the element
+ * @param user Unused
+ */
+static void
+hashtable_test_value_incr(const char *key, size_t key_len, void *e, size_t size, void *user) {
+
+    if (sizeof(int) == size) {
+        (*(int *)e)++;
+    }
+}
+
+/**
+ * @brief Increment the element in place if it is found, used by hashtable_test_callbacks
+ * @param key Key of the element
+ * @param key_len Length of the key in bytes
+ * @param found true if the key is found
+ * @param e Element of the hashtable, an int
+ * @param size Size of the element
+ * @param user Action to be returned
+ * @return Action given as user data
+ */
+static hashtable_compute_t
+hashtable_test_compute_incr(const char *key, size_t key_len, bool found, void **e, size_t *size, void *user) {
+
+    if ((true == found) && (sizeof(int) == *size)) {
+        (*(int *)*e)++;
+    }
+
+    return *(hashtable_compute_t *)user;
+}
+
+/**
+ * @brief Add, lookup and remove elements of the thread while the elements shared by all threads are looked up, used by hashtable_test_threads
+ * @param arg Thread of the test
+ * @return Thread of the test, with the result of its checks
+ */
+static void *
+hashtable_test_thread(void *arg) {
+
+    hashtable_test_thread_t *thread = (hashtable_test_thread_t *)arg;
+
+    thread->ret = hashtable_test_thread_run(thread);
+
+    return thread;
+}
+
+/**
+ * @brief Run the checks of a thread, used by hashtable_test_thread
+ * @param thread Thread of the test
+ * @return 0 if the checks succeeded, -1 otherwise
+ */
+static int
+hashtable_test_thread_run(hashtable_test_thread_t *thread) {
+
+    char key[32];
+
+    /* Add the elements of the thread, the elements shared by all threads are looked up meanwhile */
+    for (int index = 0; index < HASHTABLE_TEST_COUNT / HASHTABLE_TEST_THREADS; index++) {
+        snprintf(key, sizeof(key), "thread%d-%d", thread->index, index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(thread->hashtable, key, &index, sizeof(index)));
+        snprintf(key, sizeof(key), "shared%d", index % 100);
+        int *e = (int *)hashtable_lookup(thread->hashtable, key);
+        HASHTABLE_TEST_CHECK((NULL != e) && (index % 100 == *e));
+    }
+
+    /* Remove half of the elements of the thread, the other elements are still found */
+    for (int index = 0; index < HASHTABLE_TEST_COUNT / HASHTABLE_TEST_THREADS; index++) {
+        snprintf(key, sizeof(key), "thread%d-%d", thread->index, index);
+        if (0 == index % 2) {
+            void *e = hashtable_remove(thread->hashtable, key);
+            HASHTABLE_TEST_CHECK(NULL != e);
+            free(e);
+        } else {
+            int *e = (int *)hashtable_lookup(thread->hashtable, key);
+            HASHTABLE_TEST_CHECK((NULL != e) && (index == *e));
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Increment the counter shared by all threads, used by hashtable_test_incr
+ * @param arg Thread of the test
+ * @return Thread of the test, with the result of its checks
+ */
+static void *
+hashtable_test_incr_thread(void *arg) {
+
+    hashtable_test_thread_t *thread = (hashtable_test_thread_t *)arg;
+
+    /* The counter is created by the first increment of any thread */
+    thread->ret = 0;
+    for (int index = 0; index < HASHTABLE_TEST_COUNT; index++) {
+        if (0 != hashtable_incr(thread->hashtable, "counter", 1, NULL)) {
+            thread->ret = -1;
+        }
+    }
+
+    return thread;
+}
+
+/**
+ * @brief Check that the hashtable grows and shrinks while elements are added and removed
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_resize(void) {
+
+    hashtable_config_t config;
+    char               key[32];
+
+    /* Create hashtable instance */
+    hashtable_config_init(&config);
+    config.size   = 16;
+    config.alloc  = true;
+    config.shrink = true;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+
+    /* Add elements, the hashtable is grown while they are added */
+    for (int index = 0; index < HASHTABLE_TEST_COUNT; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+    HASHTABLE_TEST_CHECK(HASHTABLE_TEST_COUNT == hashtable_get_count(hashtable));
+    for (int index = 0; index < HASHTABLE_TEST_COUNT; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        int *e = (int *)hashtable_lookup(hashtable, key);
+        HASHTABLE_TEST_CHECK((NULL != e) && (index == *e));
+    }
+
+    /* Remove most elements, the hashtable is shrunk while they are removed */
+    for (int index = 0; index < HASHTABLE_TEST_COUNT - 10; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        void *e = hashtable_remove(hashtable, key);
+        HASHTABLE_TEST_CHECK(NULL != e);
+        free(e);
+    }
+    HASHTABLE_TEST_CHECK(10 == hashtable_get_count(hashtable));
+    for (int index = HASHTABLE_TEST_COUNT - 10; index < HASHTABLE_TEST_COUNT; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, key));
+    }
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that a full scan visits all elements, even if the hashtable is resized between two calls
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_scan(void) {
+
+    char   key[32];
+    bool   seen[1000];
+    size_t cursor = 0;
+    int    added  = 1000;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+    for (int index = 0; index < 1000; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+
+    /* Scan the hashtable while elements are added, elements present during the whole scan are visited at least once */
+    memset(seen, 0, sizeof(seen));
+    do {
+        cursor = hashtable_scan(hashtable, cursor, 4, hashtable_test_scan_cb, seen);
+        snprintf(key, sizeof(key), "new%d", added);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &added, sizeof(added)));
+        added++;
+    } while (0 != cursor);
+    for (int index = 0; index < 1000; index++) {
+        HASHTABLE_TEST_CHECK(true == seen[index]);
+    }
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that a snapshot is not modified by the elements added, replaced and removed afterwards
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_snapshot(void) {
+
+    char key[32];
+    int  value = 100;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+
+    /* Take a snapshot, then modify the hashtable, the values removed or replaced are given to the caller as copies which are released */
+    hashtable_snapshot_t *snapshot;
+    HASHTABLE_TEST_CHECK(NULL != (snapshot = hashtable_snapshot(hashtable)));
+    for (int index = 0; index < 50; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        void *e = hashtable_remove(hashtable, key);
+        HASHTABLE_TEST_CHECK(NULL != e);
+        free(e);
+    }
+    for (int index = 50; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        void *prev = NULL;
+        HASHTABLE_TEST_CHECK(0 == hashtable_replace(hashtable, key, &value, sizeof(value), &prev));
+        free(prev);
+    }
+    for (int index = 100; index < 1000; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+
+    /* Check the snapshot, it holds the elements and values when it has been taken */
+    long sum = 0;
+    HASHTABLE_TEST_CHECK(100 == hashtable_snapshot_get_count(snapshot));
+    for (size_t index = 0; index < hashtable_snapshot_get_count(snapshot); index++) {
+        const char *k;
+        void *      e;
+        HASHTABLE_TEST_CHECK(true == hashtable_snapshot_get(snapshot, index, &k, NULL, &e));
+        HASHTABLE_TEST_CHECK(0 == strncmp(k, "key", 3));
+        sum += *(int *)e;
+    }
+    HASHTABLE_TEST_CHECK(99 * 100 / 2 == sum);
+    HASHTABLE_TEST_CHECK(false == hashtable_snapshot_get(snapshot, 100, NULL, NULL, NULL));
+
+    /* Release memory */
+    hashtable_snapshot_release(snapshot);
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that elements expire after their time to live
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_ttl(void) {
+
+    int value = 0;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+
+    /* Add elements with short and long times to live, and without time to live */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_ttl(hashtable, "short1", &value, sizeof(value), 20));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_ttl(hashtable, "short2", &value, sizeof(value), 100));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_ttl(hashtable, "long", &value, sizeof(value), 24 * 3600 * 1000));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_ttl(hashtable, "none", &value, sizeof(value), 0));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_ttl(hashtable, "cleared", &value, sizeof(value), 20));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "cleared", &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "short1"));
+
+    /* Wait for the short times to live, elements which have expired are not found anymore and are removed */
+    usleep(200 * 1000);
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "short1"));
+    HASHTABLE_TEST_CHECK(2 == hashtable_expire(hashtable));
+    HASHTABLE_TEST_CHECK(3 == hashtable_get_count(hashtable));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "long"));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "none"));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "cleared"));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that bounded hashtables evict elements and do not admit keys loaded once in place of frequent ones
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_eviction(void) {
+
+    hashtable_config_t config;
+    char               key[32];
+    size_t             loads = 0;
+
+    /* Create bounded hashtable instance, elements are evicted once the capacity is reached */
+    hashtable_config_init(&config);
+    config.alloc    = true;
+    config.shards   = 1;
+    config.capacity = 8;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+        HASHTABLE_TEST_CHECK(8 >= hashtable_get_count(hashtable));
+    }
+    HASHTABLE_TEST_CHECK(8 == hashtable_get_count(hashtable));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "key99"));
+    hashtable_release(hashtable);
+
+    /* Create bounded hashtable instance with admission, loaded keys are only stored if they are more frequent than the element they evict */
+    config.admission = true;
+    config.refcount  = true;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int round = 0; round < 20; round++) {
+        for (int index = 0; index < 8; index++) {
+            snprintf(key, sizeof(key), "hot%d", index);
+            char *e = (char *)hashtable_get_or_load(hashtable, key, hashtable_test_load, &loads);
+            HASHTABLE_TEST_CHECK((NULL != e) && (0 == strcmp(e, key)));
+            hashtable_value_release(hashtable, e);
+        }
+    }
+    HASHTABLE_TEST_CHECK(8 == loads);
+
+    /* Load keys once while the frequent keys are still accessed, the keys loaded once are returned even if they are not stored */
+    for (int index = 0; index < 1000; index++) {
+        snprintf(key, sizeof(key), "hot%d", index % 8);
+        char *e = (char *)hashtable_get_or_load(hashtable, key, hashtable_test_load, &loads);
+        HASHTABLE_TEST_CHECK(NULL != e);
+        hashtable_value_release(hashtable, e);
+        snprintf(key, sizeof(key), "cold%d", index);
+        e = (char *)hashtable_get_or_load(hashtable, key, hashtable_test_load, &loads);
+        HASHTABLE_TEST_CHECK((NULL != e) && (0 == strcmp(e, key)));
+        hashtable_value_release(hashtable, e);
+    }
+    for (int index = 0; index < 8; index++) {
+        snprintf(key, sizeof(key), "hot%d", index);
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, key));
+    }
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that reference counted values remain valid once removed or replaced
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_refcount(void) {
+
+    hashtable_config_t config;
+    hashtable_entry_t  entry;
+
+    /* Create hashtable instance with reference counted values, lookups do not lock the shards */
+    hashtable_config_init(&config);
+    config.alloc    = true;
+    config.refcount = true;
+    config.lock     = HASHTABLE_LOCK_RCU;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", "value1", 7));
+
+    /* The values looked up remain valid once they are replaced or removed */
+    char *e1 = (char *)hashtable_lookup(hashtable, "key");
+    HASHTABLE_TEST_CHECK((NULL != e1) && (0 == strcmp(e1, "value1")));
+    void *prev = NULL;
+    HASHTABLE_TEST_CHECK(0 == hashtable_replace(hashtable, "key", "value2", 7, &prev));
+    HASHTABLE_TEST_CHECK(prev == e1);
+    hashtable_value_release(hashtable, prev);
+    char *e2 = (char *)hashtable_lookup(hashtable, "key");
+    HASHTABLE_TEST_CHECK((NULL != e2) && (0 == strcmp(e2, "value2")));
+    void *removed = hashtable_remove(hashtable, "key");
+    HASHTABLE_TEST_CHECK(removed == e2);
+    hashtable_value_release(hashtable, removed);
+    HASHTABLE_TEST_CHECK(0 == strcmp(e1, "value1"));
+    HASHTABLE_TEST_CHECK(0 == strcmp(e2, "value2"));
+    hashtable_value_release(hashtable, e1);
+    hashtable_value_release(hashtable, e2);
+
+    /* The entry holds a reference to the value until it is removed */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", "value3", 7));
+    HASHTABLE_TEST_CHECK(true == hashtable_find(hashtable, "key", &entry));
+    HASHTABLE_TEST_CHECK(0 == strcmp((char *)entry.e, "value3"));
+    HASHTABLE_TEST_CHECK(0 == hashtable_entry_set_value(hashtable, &entry, "value4", 7));
+    HASHTABLE_TEST_CHECK(0 == strcmp((char *)entry.e, "value4"));
+    HASHTABLE_TEST_CHECK(0 == hashtable_entry_remove(hashtable, &entry, &removed));
+    HASHTABLE_TEST_CHECK((NULL != removed) && (0 == strcmp((char *)removed, "value4")));
+    hashtable_value_release(hashtable, removed);
+    HASHTABLE_TEST_CHECK(0 == hashtable_get_count(hashtable));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that elements are only replaced if their version matches
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_version(void) {
+
+    uint64_t version  = 0;
+    uint64_t current  = 0;
+    int      value    = 1;
+    int      conflict = 2;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+
+    /* The element is only added if the key is not found when the version is 0 */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_if_version(hashtable, "key", &value, sizeof(value), 0));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_add_if_version(hashtable, "key", &value, sizeof(value), 0));
+
+    /* The element is only replaced if it has not been modified since it has been looked up */
+    HASHTABLE_TEST_CHECK(NULL != hashtable_lookup_versioned(hashtable, "key", &version));
+    HASHTABLE_TEST_CHECK(0 != version);
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", &conflict, sizeof(conflict)));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_add_if_version(hashtable, "key", &value, sizeof(value), version));
+    int *e = (int *)hashtable_lookup_versioned(hashtable, "key", &current);
+    HASHTABLE_TEST_CHECK((NULL != e) && (conflict == *e) && (current != version));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_if_version(hashtable, "key", &value, sizeof(value), current));
+    e = (int *)hashtable_lookup_versioned(hashtable, "key", &version);
+    HASHTABLE_TEST_CHECK((NULL != e) && (value == *e) && (current != version));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that threads adding, looking up and removing elements concurrently do not lose any of them
+ * @param lock Locking mode of the hashtable
+ * @param shards Number of shards of the hashtable
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_threads(hashtable_lock_t lock, size_t shards) {
+
+    hashtable_config_t      config;
+    hashtable_test_thread_t threads[HASHTABLE_TEST_THREADS];
+    char                    key[32];
+    int                     ret = 0;
+
+    /* Create hashtable instance with the elements shared by all threads, the hashtable is grown while the threads add their elements */
+    hashtable_config_init(&config);
+    config.size   = 16;
+    config.alloc  = true;
+    config.lock   = lock;
+    config.shards = shards;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "shared%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+
+    /* Run the threads, each of them adds and removes its own elements */
+    for (int index = 0; index < HASHTABLE_TEST_THREADS; index++) {
+        threads[index].hashtable = hashtable;
+        threads[index].index     = index;
+        threads[index].ret       = -1;
+        HASHTABLE_TEST_CHECK(0 == pthread_create(&threads[index].thread, NULL, hashtable_test_thread, &threads[index]));
+    }
+    for (int index = 0; index < HASHTABLE_TEST_THREADS; index++) {
+        pthread_join(threads[index].thread, NULL);
+        ret |= threads[index].ret;
+    }
+    HASHTABLE_TEST_CHECK(0 == ret);
+    HASHTABLE_TEST_CHECK(100 + HASHTABLE_TEST_COUNT / 2 == hashtable_get_count(hashtable));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that binary keys containing NUL characters are distinct from their prefixes and from each other
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_binary(void) {
+
+    const char key1[] = { 'k', '\0', '1' };
+    const char key2[] = { 'k', '\0', '2' };
+    int        value1 = 1;
+    int        value2 = 2;
+    int        value3 = 3;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+
+    /* Add keys only differing after a NUL character, and their common prefix as a string */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_n(hashtable, key1, sizeof(key1), &value1, sizeof(value1)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_n(hashtable, key2, sizeof(key2), &value2, sizeof(value2)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "k", &value3, sizeof(value3)));
+    HASHTABLE_TEST_CHECK(3 == hashtable_get_count(hashtable));
+
+    /* Each key gets its own element, the string functions access the key without its NUL character */
+    int *e = (int *)hashtable_lookup_n(hashtable, key1, sizeof(key1));
+    HASHTABLE_TEST_CHECK((NULL != e) && (value1 == *e));
+    e = (int *)hashtable_lookup_n(hashtable, key2, sizeof(key2));
+    HASHTABLE_TEST_CHECK((NULL != e) && (value2 == *e));
+    e = (int *)hashtable_lookup_n(hashtable, "k", 1);
+    HASHTABLE_TEST_CHECK((NULL != e) && (value3 == *e));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key_n(hashtable, key1, 2));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key_n(hashtable, "k", 2));
+
+    /* Removing a binary key leaves the other ones */
+    void *removed = hashtable_remove_n(hashtable, key1, sizeof(key1));
+    HASHTABLE_TEST_CHECK((NULL != removed) && (value1 == *(int *)removed));
+    free(removed);
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key_n(hashtable, key1, sizeof(key1)));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key_n(hashtable, key2, sizeof(key2)));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "k"));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that the hash functions are selected and seeded as configured, and that keys colliding on the whole hash value are distinct
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_hash(void) {
+
+    hashtable_config_t config;
+    char               key[32];
+    bool               same = false;
+
+    /* Seeded hash functions give the same order for the same seed only, djb2 ignores the seed */
+    HASHTABLE_TEST_CHECK((0 == hashtable_test_hash_order(HASHTABLE_HASH_WYHASH, 42, 42, &same)) && (true == same));
+    HASHTABLE_TEST_CHECK((0 == hashtable_test_hash_order(HASHTABLE_HASH_WYHASH, 42, 43, &same)) && (false == same));
+    HASHTABLE_TEST_CHECK((0 == hashtable_test_hash_order(HASHTABLE_HASH_SIPHASH, 42, 42, &same)) && (true == same));
+    HASHTABLE_TEST_CHECK((0 == hashtable_test_hash_order(HASHTABLE_HASH_SIPHASH, 42, 43, &same)) && (false == same));
+    HASHTABLE_TEST_CHECK((0 == hashtable_test_hash_order(HASHTABLE_HASH_DJB2, 42, 43, &same)) && (true == same));
+
+    /* Create hashtable instance with a custom hash function, which is given the seed and makes all keys collide */
+    hashtable_config_init(&config);
+    config.alloc    = true;
+    config.hash_fct = hashtable_test_hash_fct;
+    config.seed     = 42;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+    HASHTABLE_TEST_CHECK(42 == hashtable_test_hash_seed);
+    HASHTABLE_TEST_CHECK(100 == hashtable_get_count(hashtable));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        int *e = (int *)hashtable_lookup(hashtable, key);
+        HASHTABLE_TEST_CHECK((NULL != e) && (index == *e));
+    }
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "key100"));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that batched lookups find the same elements as single lookups, across shards and groups of keys
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_batch(void) {
+
+    hashtable_config_t config;
+    static char        names[601][32];
+    char *             keys[601];
+    void *             values[601];
+    uint8_t            bitmap[(601 + 7) / 8];
+
+    /* Create sharded hashtable instance, only the keys of even index are added */
+    hashtable_config_init(&config);
+    config.alloc  = true;
+    config.shards = 4;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 601; index++) {
+        snprintf(names[index], sizeof(names[index]), "key%d", index);
+        keys[index] = names[index];
+        if (0 == index % 2) {
+            HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, keys[index], &index, sizeof(index)));
+        }
+    }
+
+    /* Lookup more keys than a group, the last key is the same as the first one */
+    keys[600] = keys[0];
+    HASHTABLE_TEST_CHECK(301 == hashtable_lookup_batch(hashtable, keys, 601, values));
+    for (int index = 0; index < 600; index++) {
+        HASHTABLE_TEST_CHECK(values[index] == hashtable_lookup(hashtable, keys[index]));
+        HASHTABLE_TEST_CHECK((0 == index % 2) == (NULL != values[index]));
+    }
+    HASHTABLE_TEST_CHECK(values[600] == values[0]);
+
+    /* Check the keys, the bits of the keys not found are cleared */
+    memset(bitmap, 0xFF, sizeof(bitmap));
+    HASHTABLE_TEST_CHECK(301 == hashtable_has_key_batch(hashtable, keys, 601, bitmap));
+    for (int index = 0; index < 601; index++) {
+        HASHTABLE_TEST_CHECK((0 == index % 2) == (0 != (bitmap[index / 8] & (1 << (index % 8)))));
+    }
+    HASHTABLE_TEST_CHECK(0 == hashtable_lookup_batch(hashtable, keys, 0, values));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that bulk additions update the existing elements and the duplicated keys, and that their blocks are released with their elements
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_bulk(void) {
+
+    hashtable_config_t config;
+    static char        names[3000][32];
+    static char *      keys[3000];
+    static int         values[3000];
+    static void *      ptrs[3000];
+    static size_t      sizes[3000];
+    int                value = -1;
+
+    /* Prepare more keys than a block, the last keys are duplicates of the first ones with other values */
+    for (int index = 0; index < 3000; index++) {
+        snprintf(names[index], sizeof(names[index]), "key%d", index % 2500);
+        keys[index]   = names[index];
+        values[index] = (index < 2500) ? index : index % 2500 + 10000;
+        ptrs[index]   = &values[index];
+        sizes[index]  = sizeof(values[index]);
+    }
+
+    /* Create sharded hashtable instance with an existing key, which is updated by the bulk addition */
+    hashtable_config_init(&config);
+    config.size   = 16;
+    config.alloc  = true;
+    config.shards = 2;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key0", &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_bulk(hashtable, keys, ptrs, sizes, 3000, false));
+    HASHTABLE_TEST_CHECK(2500 == hashtable_get_count(hashtable));
+    for (int index = 0; index < 2500; index++) {
+        int *e = (int *)hashtable_lookup(hashtable, keys[index]);
+        HASHTABLE_TEST_CHECK((NULL != e) && (((index < 500) ? index + 10000 : index) == *e));
+    }
+
+    /* Remove the elements, the blocks are released with their last element */
+    for (int index = 0; index < 2500; index++) {
+        void *e = hashtable_remove(hashtable, keys[index]);
+        HASHTABLE_TEST_CHECK(NULL != e);
+        free(e);
+    }
+    HASHTABLE_TEST_CHECK(0 == hashtable_get_count(hashtable));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_bulk(hashtable, keys, ptrs, sizes, 2500, true));
+    HASHTABLE_TEST_CHECK(2500 == hashtable_get_count(hashtable));
+    hashtable_release(hashtable);
+
+    /* Create bounded hashtable instance, the elements added in bulk are evicted as the other ones */
+    config.capacity = 100;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_bulk(hashtable, keys, ptrs, sizes, 2500, true));
+    HASHTABLE_TEST_CHECK(100 == hashtable_get_count(hashtable));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that pre-hashed keys are reused by hashtables sharing their hash function and seed, and hashed again by the other ones
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_prehashed(void) {
+
+    hashtable_config_t config;
+    hashtable_t *      hashtable[4];
+    hashtable_key_t    hk;
+    int                value = 1;
+
+    /* Create hashtable instances, the first two share their hash function and seed, the other ones have another seed or a custom hash function */
+    hashtable_config_init(&config);
+    config.alloc = true;
+    config.seed  = 1;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[0] = hashtable_create_with_config(&config)));
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[1] = hashtable_create_with_config(&config)));
+    config.seed = 2;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[2] = hashtable_create_with_config(&config)));
+    config.hash_fct = hashtable_test_hash_fct;
+    config.seed     = 3;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable[3] = hashtable_create_with_config(&config)));
+
+    /* The key is hashed for the first hashtable, the hash value is reused by the second one */
+    hashtable_key_init(hashtable[0], &hk, "key", 3);
+    uint64_t hash_id = hk.hash_id;
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_hk(hashtable[0], &hk, &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_hk(hashtable[1], &hk, &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(hash_id == hk.hash_id);
+
+    /* The key is hashed again for the hashtables having another seed or hash function, and then for the first hashtable again */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_hk(hashtable[2], &hk, &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(hash_id != hk.hash_id);
+    hashtable_test_hash_seed = 0;
+    HASHTABLE_TEST_CHECK(0 == hashtable_add_hk(hashtable[3], &hk, &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK((3 == hashtable_test_hash_seed) && (3 == hk.hash));
+    HASHTABLE_TEST_CHECK(NULL != hashtable_lookup_hk(hashtable[0], &hk));
+    HASHTABLE_TEST_CHECK(hash_id == hk.hash_id);
+
+    /* The elements added with the pre-hashed key are found with the key in all hashtables */
+    for (int index = 0; index < 4; index++) {
+        int *e = (int *)hashtable_lookup(hashtable[index], "key");
+        HASHTABLE_TEST_CHECK((NULL != e) && (value == *e));
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key_hk(hashtable[index], &hk));
+    }
+
+    /* Release memory */
+    for (int index = 0; index < 4; index++) {
+        hashtable_release(hashtable[index]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check that entries update and remove their element, and are not valid anymore once an element of their shard has been removed
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_entry(void) {
+
+    hashtable_entry_t entry;
+    int               value1 = 1;
+    int               value2 = 2;
+    void *            removed;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key1", &value1, sizeof(value1)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key2", &value2, sizeof(value2)));
+    HASHTABLE_TEST_CHECK(false == hashtable_find(hashtable, "key3", &entry));
+
+    /* The entry can be updated several times, updating an element does not invalidate the entry */
+    HASHTABLE_TEST_CHECK(true == hashtable_find(hashtable, "key1", &entry));
+    HASHTABLE_TEST_CHECK((entry.e == hashtable_lookup(hashtable, "key1")) && (value1 == *(int *)entry.e));
+    HASHTABLE_TEST_CHECK(0 == hashtable_entry_set_value(hashtable, &entry, &value2, sizeof(value2)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key2", &value1, sizeof(value1)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_entry_set_value(hashtable, &entry, &value1, sizeof(value1)));
+    HASHTABLE_TEST_CHECK(value1 == *(int *)hashtable_lookup(hashtable, "key1"));
+
+    /* Removing another element of the shard invalidates the entry, which has to be found again */
+    removed = hashtable_remove(hashtable, "key2");
+    HASHTABLE_TEST_CHECK(NULL != removed);
+    free(removed);
+    HASHTABLE_TEST_CHECK(-1 == hashtable_entry_set_value(hashtable, &entry, &value2, sizeof(value2)));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_entry_remove(hashtable, &entry, &removed));
+    HASHTABLE_TEST_CHECK(value1 == *(int *)hashtable_lookup(hashtable, "key1"));
+    HASHTABLE_TEST_CHECK(true == hashtable_find(hashtable, "key1", &entry));
+    HASHTABLE_TEST_CHECK(0 == hashtable_entry_remove(hashtable, &entry, &removed));
+    HASHTABLE_TEST_CHECK((NULL != removed) && (value1 == *(int *)removed));
+    free(removed);
+    HASHTABLE_TEST_CHECK(0 == hashtable_get_count(hashtable));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that elements are only added by lookup_or_add and lookup_or_create if their key is not found, and that replace returns the previous element
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_upsert(void) {
+
+    int    value1 = 1;
+    int    value2 = 2;
+    size_t loads  = 0;
+    void * prev   = NULL;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+
+    /* The element is added if the key is not found, the element found is returned otherwise */
+    int *e = (int *)hashtable_lookup_or_add(hashtable, "key", &value1, sizeof(value1));
+    HASHTABLE_TEST_CHECK((NULL != e) && (&value1 != e) && (value1 == *e));
+    HASHTABLE_TEST_CHECK(e == hashtable_lookup_or_add(hashtable, "key", &value2, sizeof(value2)));
+    HASHTABLE_TEST_CHECK((value1 == *e) && (1 == hashtable_get_count(hashtable)));
+
+    /* The element is only created if the key is not found */
+    char *created = (char *)hashtable_lookup_or_create(hashtable, "created", hashtable_test_load, &loads);
+    HASHTABLE_TEST_CHECK((NULL != created) && (0 == strcmp(created, "created")) && (1 == loads));
+    HASHTABLE_TEST_CHECK(created == hashtable_lookup_or_create(hashtable, "created", hashtable_test_load, &loads));
+    HASHTABLE_TEST_CHECK(1 == loads);
+    HASHTABLE_TEST_CHECK(e == hashtable_lookup_or_create(hashtable, "key", hashtable_test_load, &loads));
+    HASHTABLE_TEST_CHECK(1 == loads);
+
+    /* The element replaced is returned, or NULL if the key was not found */
+    HASHTABLE_TEST_CHECK(0 == hashtable_replace(hashtable, "key", &value2, sizeof(value2), &prev));
+    HASHTABLE_TEST_CHECK(prev == e);
+    free(prev);
+    e = (int *)hashtable_lookup(hashtable, "key");
+    HASHTABLE_TEST_CHECK((NULL != e) && (value2 == *e));
+    HASHTABLE_TEST_CHECK(0 == hashtable_replace(hashtable, "new", &value1, sizeof(value1), &prev));
+    HASHTABLE_TEST_CHECK((NULL == prev) && (3 == hashtable_get_count(hashtable)));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that counters are created and incremented, including by concurrent threads without lock
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_incr(void) {
+
+    hashtable_config_t      config;
+    hashtable_test_thread_t threads[HASHTABLE_TEST_THREADS];
+    int64_t                 value = 0;
+    int                     ret   = 0;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+
+    /* The counter is created with the first delta, then incremented, lookups return a pointer to its value */
+    HASHTABLE_TEST_CHECK((0 == hashtable_incr(hashtable, "counter", 5, &value)) && (5 == value));
+    HASHTABLE_TEST_CHECK((0 == hashtable_incr(hashtable, "counter", -7, &value)) && (-2 == value));
+    int64_t *counter = (int64_t *)hashtable_lookup(hashtable, "counter");
+    HASHTABLE_TEST_CHECK((NULL != counter) && (-2 == *counter));
+
+    /* Elements which are not counters are not incremented, removed counters are created again */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", &value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_incr(hashtable, "key", 1, NULL));
+    HASHTABLE_TEST_CHECK(NULL == hashtable_remove(hashtable, "counter"));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "counter"));
+    HASHTABLE_TEST_CHECK((0 == hashtable_incr(hashtable, "counter", 3, &value)) && (3 == value));
+    hashtable_release(hashtable);
+
+    /* Increment a counter from several threads, with the read-write lock and without lock */
+    hashtable_lock_t locks[] = { HASHTABLE_LOCK_RWLOCK, HASHTABLE_LOCK_RCU };
+    for (size_t lock = 0; lock < sizeof(locks) / sizeof(locks[0]); lock++) {
+        hashtable_config_init(&config);
+        config.alloc = true;
+        config.lock  = locks[lock];
+        HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+        for (int index = 0; index < HASHTABLE_TEST_THREADS; index++) {
+            threads[index].hashtable = hashtable;
+            threads[index].index     = index;
+            threads[index].ret       = -1;
+            HASHTABLE_TEST_CHECK(0 == pthread_create(&threads[index].thread, NULL, hashtable_test_incr_thread, &threads[index]));
+        }
+        for (int index = 0; index < HASHTABLE_TEST_THREADS; index++) {
+            pthread_join(threads[index].thread, NULL);
+            ret |= threads[index].ret;
+        }
+        HASHTABLE_TEST_CHECK(0 == ret);
+        HASHTABLE_TEST_CHECK((0 == hashtable_incr(hashtable, "counter", 0, &value)) && (HASHTABLE_TEST_THREADS * HASHTABLE_TEST_COUNT == value));
+        hashtable_release(hashtable);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check that bounded hashtables evict elements to stay within their memory and do not add elements larger than it
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_memory(void) {
+
+    hashtable_config_t config;
+    char               key[32];
+    static char        value[8192];
+
+    /* Create bounded hashtable instance, elements are evicted once the memory is reached */
+    hashtable_config_init(&config);
+    config.alloc  = true;
+    config.shards = 1;
+    config.memory = 4096;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, value, 64));
+        HASHTABLE_TEST_CHECK(4096 >= hashtable_get_memory(hashtable));
+    }
+    size_t count = hashtable_get_count(hashtable);
+    HASHTABLE_TEST_CHECK((1 < count) && (100 > count));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "key99"));
+
+    /* Growing an element evicts other elements, elements larger than the memory are not added */
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key99", value, 1024));
+    HASHTABLE_TEST_CHECK(4096 >= hashtable_get_memory(hashtable));
+    HASHTABLE_TEST_CHECK(count > hashtable_get_count(hashtable));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_add(hashtable, "large", value, sizeof(value)));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "large"));
+    HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, "key99"));
+
+    /* The memory of the elements removed is given back */
+    for (int index = 0; index < 100; index++) {
+        snprintf(key, sizeof(key), "key%d", index);
+        free(hashtable_remove(hashtable, key));
+    }
+    HASHTABLE_TEST_CHECK((0 == hashtable_get_count(hashtable)) && (0 == hashtable_get_memory(hashtable)));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that compute, add_if_version and incr do not add elements which are not admitted
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_admission(void) {
+
+    hashtable_config_t config;
+    char               key[32];
+    int                value = 1;
+
+    /* Create bounded hashtable instance with admission, filled with frequent keys */
+    hashtable_config_init(&config);
+    config.alloc     = true;
+    config.shards    = 1;
+    config.capacity  = 8;
+    config.admission = true;
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create_with_config(&config)));
+    for (int index = 0; index < 8; index++) {
+        snprintf(key, sizeof(key), "hot%d", index);
+        HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, key, &index, sizeof(index)));
+    }
+    for (int round = 0; round < 20; round++) {
+        for (int index = 0; index < 8; index++) {
+            snprintf(key, sizeof(key), "hot%d", index);
+            HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, key));
+        }
+    }
+
+    /* Keys seen for the first time are not admitted in place of the frequent ones, whatever the function adding them */
+    HASHTABLE_TEST_CHECK(1 == hashtable_compute(hashtable, "cold1", hashtable_test_compute_set, &value));
+    HASHTABLE_TEST_CHECK(1 == hashtable_add_if_version(hashtable, "cold2", &value, sizeof(value), 0));
+    HASHTABLE_TEST_CHECK(1 == hashtable_incr(hashtable, "cold3", 1, NULL));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "cold1"));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "cold2"));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "cold3"));
+    HASHTABLE_TEST_CHECK(8 == hashtable_get_count(hashtable));
+    for (int index = 0; index < 8; index++) {
+        snprintf(key, sizeof(key), "hot%d", index);
+        HASHTABLE_TEST_CHECK(true == hashtable_has_key(hashtable, key));
+    }
+
+    /* Existing elements are updated without being submitted to the admission */
+    HASHTABLE_TEST_CHECK(0 == hashtable_compute(hashtable, "hot0", hashtable_test_compute_set, &value));
+    HASHTABLE_TEST_CHECK(value == *(int *)hashtable_lookup(hashtable, "hot0"));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that elements are copied into buffers, truncated to their length, with the size they have been added with
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_copy(void) {
+
+    char    buf[32];
+    size_t  size    = 0;
+    int64_t counter = 0;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", "0123456789", 11));
+    HASHTABLE_TEST_CHECK(0 == hashtable_incr(hashtable, "counter", 42, NULL));
+
+    /* The element is copied entirely if it fits in the buffer */
+    memset(buf, 'x', sizeof(buf));
+    HASHTABLE_TEST_CHECK((0 == hashtable_lookup_copy(hashtable, "key", buf, sizeof(buf), &size)) && (11 == size));
+    HASHTABLE_TEST_CHECK((0 == strcmp(buf, "0123456789")) && ('x' == buf[11]));
+
+    /* The element is truncated otherwise, the bytes after the buffer are not written */
+    memset(buf, 'x', sizeof(buf));
+    HASHTABLE_TEST_CHECK((0 == hashtable_lookup_copy(hashtable, "key", buf, 4, &size)) && (11 == size));
+    HASHTABLE_TEST_CHECK((0 == memcmp(buf, "0123", 4)) && ('x' == buf[4]));
+    HASHTABLE_TEST_CHECK((0 == hashtable_lookup_copy(hashtable, "key", NULL, 0, &size)) && (11 == size));
+    HASHTABLE_TEST_CHECK(0 == hashtable_lookup_copy(hashtable, "key", buf, 4, NULL));
+
+    /* Counters are copied as their value, missing keys are not copied */
+    HASHTABLE_TEST_CHECK((0 == hashtable_lookup_copy(hashtable, "counter", &counter, sizeof(counter), &size)) && (sizeof(counter) == size));
+    HASHTABLE_TEST_CHECK(42 == counter);
+    HASHTABLE_TEST_CHECK(-1 == hashtable_lookup_copy(hashtable, "missing", buf, sizeof(buf), &size));
+
+    /* Release memory */
+    hashtable_release(hashtable);
+
+    return 0;
+}
+
+/**
+ * @brief Check that with_value and compute modify the elements in place, while the snapshots keep the elements they have taken
+ * @return 0 if the test succeeded, -1 otherwise
+ */
+static int
+hashtable_test_callbacks(void) {
+
+    hashtable_compute_t action = HASHTABLE_COMPUTE_KEEP;
+    uint64_t            version1;
+    uint64_t            version2;
+    int                 value = 1;
+    void *              e;
+
+    /* Create hashtable instance */
+    hashtable_t *hashtable;
+    HASHTABLE_TEST_CHECK(NULL != (hashtable = hashtable_create(16, true)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_add(hashtable, "key", &value, sizeof(value)));
+
+    /* The element is modified in place and gets a new version */
+    HASHTABLE_TEST_CHECK(NULL != hashtable_lookup_versioned(hashtable, "key", &version1));
+    HASHTABLE_TEST_CHECK(0 == hashtable_with_value(hashtable, "key", hashtable_test_value_incr, NULL));
+    HASHTABLE_TEST_CHECK(NULL != (e = hashtable_lookup_versioned(hashtable, "key", &version2)));
+    HASHTABLE_TEST_CHECK((2 == *(int *)e) && (version1 != version2));
+    HASHTABLE_TEST_CHECK(-1 == hashtable_with_value(hashtable, "missing", hashtable_test_value_incr, NULL));
+    HASHTABLE_TEST_CHECK(0 == hashtable_compute(hashtable, "key", hashtable_test_compute_incr, &action));
+    HASHTABLE_TEST_CHECK(3 == *(int *)hashtable_lookup(hashtable, "key"));
+    HASHTABLE_TEST_CHECK(0 == hashtable_compute(hashtable, "missing", hashtable_test_compute_incr, &action));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "missing"));
+
+    /* The element modified while a snapshot includes it is a copy, the snapshot keeps the element it has taken */
+    hashtable_snapshot_t *snapshot;
+    HASHTABLE_TEST_CHECK(NULL != (snapshot = hashtable_snapshot(hashtable)));
+    HASHTABLE_TEST_CHECK(0 == hashtable_with_value(hashtable, "key", hashtable_test_value_incr, NULL));
+    HASHTABLE_TEST_CHECK(4 == *(int *)hashtable_lookup(hashtable, "key"));
+    HASHTABLE_TEST_CHECK(0 == hashtable_compute(hashtable, "key", hashtable_test_compute_incr, &action));
+    HASHTABLE_TEST_CHECK(5 == *(int *)hashtable_lookup(hashtable, "key"));
+    HASHTABLE_TEST_CHECK((true == hashtable_snapshot_get(snapshot, 0, NULL, NULL, &e)) && (3 == *(int *)e));
+
+    /* The element is removed by compute, the snapshot still keeps it */
+    action = HASHTABLE_COMPUTE_REMOVE;
+    HASHTABLE_TEST_CHECK(0 == hashtable_compute(hashtable, "key", hashtable_test_compute_incr, &action));
+    HASHTABLE_TEST_CHECK(false == hashtable_has_key(hashtable, "key"));
+    HASHTABLE_TEST_CHECK((true == hashtable_snapshot_get(snapshot, 0, NULL, NULL, &e)) && (3 == *(int *)e));
+
+    /* Release memory */
+    hashtable_snapshot_release(snapshot);
+    hashtable_release(hashtable);
+
+    return 0;
+}